@@ -48,6 +48,11 @@ final class NativeZip {
   static const deflate = ZipStreamConverter._(1, _TYPE_DEFLATE);
   static const inflate = ZipStreamConverter._(0, _TYPE_DEFLATE);
 
+  /// version of zlib used by native library, e.g. "1.3.1",
+  /// or ends with ".zlib-ng" if built with zlib-ng (SIMD optimized)
+  static String get zlibVersion =>
+      _bindings.getZlibVersion().cast<Utf8>().toDartString();
+
   //
 
   /// open or create zip file
@@ -68,14 +73,25 @@ final class NativeZip {
   ///
   /// [compressLevel] parameter must be between 0 and 9. 0 means no compression, 1 means fast compression but low compression ratio, and 9 means the slowest compression but the highest compression ratio. Default is 5
   ///
-  /// [threadCount] default set to [Platform.numberOfProcessors]. In other words, use 100% of CPU
+  /// [threadCount] default is the number of CPUs this process can use (CPU affinity and container CPU quota are respected). In other words, use 100% of CPU
+  ///
+  /// [storeDetect] decides how to find already compressed files (e.g. .jpg, .zip), which are stored without compression, see [ZipStoreDetect]
+  ///
+  /// [maxBlockSize] and [maxMemoryUsage] limit the size of each compressed block and memory used by all blocks, 0 means auto. Refer to [ZipFile.addFile]
+  ///
+  /// If [blockIndex] is true, large files can be extracted by all threads of [unzipToDir]. Refer to [ZipFile.addFile]
   static ZipTaskFuture zipDir(
     String dirPath,
     String zipPath, {
     String? password,
     int compressLevel = 5,
+    ZipCompressMethod compressMethod = ZipCompressMethod.deflate,
     bool skipTopLevel = false,
     int threadCount = 0,
+    int maxBlockSize = 0,
+    int maxMemoryUsage = 0,
+    int storeDetect = ZipStoreDetect.all,
+    bool blockIndex = false,
   }) {
     if (_isFileExists(zipPath)) {
       throw ZipFileCreateException("Zip file already exists: $zipPath");
@@ -89,8 +105,13 @@ final class NativeZip {
       dirPath,
       "",
       compressLevel: compressLevel,
+      compressMethod: compressMethod,
       skipTopLevel: skipTopLevel,
       threadCount: threadCount,
+      maxBlockSize: maxBlockSize,
+      maxMemoryUsage: maxMemoryUsage,
+      storeDetect: storeDetect,
+      blockIndex: blockIndex,
     );
     future.whenComplete(() => zip.close());
     return future;
@@ -102,19 +123,22 @@ final class NativeZip {
   ///
   /// [dirPath] is directory path where you store the extracted .zip file.
   ///
-  /// [threadCount] default set to [Platform.numberOfProcessors]. In other words, use 100% of CPU
+  /// [threadCount] default is the number of CPUs this process can use (CPU affinity and container CPU quota are respected). In other words, use 100% of CPU
+  ///
+  /// If [noCache] is true, extracted large files don't stay in OS page cache. Refer to [ZipFile.saveTo]
   static ZipTaskFuture unzipToDir(
     String zipPath,
     String dirPath, {
     String? password,
     int threadCount = 0,
+    bool noCache = false,
   }) {
     if (!_isFileExists(zipPath)) {
       throw ZipFileOpenException("Zip file not exists: $zipPath");
     }
 
     var zip = openZipFile(zipPath, password: password);
-    var future = zip.saveTo("", dirPath, threadCount: threadCount);
+    var future = zip.saveTo("", dirPath, threadCount: threadCount, noCache: noCache);
     future.whenComplete(() {
       zip.close();
     });
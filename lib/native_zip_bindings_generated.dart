@@ -160,25 +160,45 @@ class NativeZipBindings {
   late final _closeUnzipStream =
       _closeUnzipStreamPtr.asFunction<void Function(ffi.Pointer<ffi.Void>)>();
 
+  ffi.Pointer<ffi.Char> getZlibVersion() {
+    return _getZlibVersion();
+  }
+
+  late final _getZlibVersionPtr =
+      _lookup<ffi.NativeFunction<ffi.Pointer<ffi.Char> Function()>>(
+          'getZlibVersion');
+  late final _getZlibVersion =
+      _getZlibVersionPtr.asFunction<ffi.Pointer<ffi.Char> Function()>();
+
   ffi.Pointer<ffi.Void> zipDirAsync(
     ffi.Pointer<ffi.Void> _zip,
-    bool hasPassword,
+    ffi.Pointer<ffi.Char> zipFilePath,
+    ffi.Pointer<ffi.Char> password,
     ffi.Pointer<ffi.Pointer<ffi.Char>> dirPathList,
     int dirPathListCount,
     ffi.Pointer<ffi.Char> entryDirPathBase,
     int compressLevel,
+    int compressMethod,
     int skipTopLevel,
     int threadCount,
+    int maxBlockSize,
+    int maxMemoryUsage,
+    int flags,
   ) {
     return _zipDirAsync(
       _zip,
-      hasPassword,
+      zipFilePath,
+      password,
       dirPathList,
       dirPathListCount,
       entryDirPathBase,
       compressLevel,
+      compressMethod,
       skipTopLevel,
       threadCount,
+      maxBlockSize,
+      maxMemoryUsage,
+      flags,
     );
   }
 
@@ -186,22 +206,32 @@ class NativeZipBindings {
       ffi.NativeFunction<
           ffi.Pointer<ffi.Void> Function(
               ffi.Pointer<ffi.Void>,
-              ffi.Bool,
+              ffi.Pointer<ffi.Char>,
+              ffi.Pointer<ffi.Char>,
               ffi.Pointer<ffi.Pointer<ffi.Char>>,
               ffi.Int,
               ffi.Pointer<ffi.Char>,
               ffi.Int,
               ffi.Int,
+              ffi.Int,
+              ffi.Int,
+              ffi.Int64,
+              ffi.Int64,
               ffi.Int)>>('zipDirAsync');
   late final _zipDirAsync = _zipDirAsyncPtr.asFunction<
       ffi.Pointer<ffi.Void> Function(
           ffi.Pointer<ffi.Void>,
-          bool,
+          ffi.Pointer<ffi.Char>,
+          ffi.Pointer<ffi.Char>,
           ffi.Pointer<ffi.Pointer<ffi.Char>>,
           int,
           ffi.Pointer<ffi.Char>,
           int,
           int,
+          int,
+          int,
+          int,
+          int,
           int)>();
 
   ffi.Pointer<ffi.Void> unzipToDirAsync(
@@ -212,6 +242,7 @@ class NativeZipBindings {
     int entriesCount,
     ffi.Pointer<ffi.Char> toDirPath,
     int threadCount,
+    int flags,
   ) {
     return _unzipToDirAsync(
       _zip,
@@ -221,6 +252,7 @@ class NativeZipBindings {
       entriesCount,
       toDirPath,
       threadCount,
+      flags,
     );
   }
 
@@ -233,6 +265,7 @@ class NativeZipBindings {
               ffi.Pointer<ffi.Pointer<ffi.Char>>,
               ffi.Int,
               ffi.Pointer<ffi.Char>,
+              ffi.Int,
               ffi.Int)>>('unzipToDirAsync');
   late final _unzipToDirAsync = _unzipToDirAsyncPtr.asFunction<
       ffi.Pointer<ffi.Void> Function(
@@ -242,6 +275,7 @@ class NativeZipBindings {
           ffi.Pointer<ffi.Pointer<ffi.Char>>,
           int,
           ffi.Pointer<ffi.Char>,
+          int,
           int)>();
 
   int zipRenameEntryAsync(
@@ -431,6 +465,23 @@ class NativeZipBindings {
       ffi.Pointer<ffi.Void> Function(
           ffi.Pointer<ffi.Void>, ffi.Pointer<ffi.Char>)>();
 
+  int getZipEntryIndex(
+    ffi.Pointer<ffi.Void> zip,
+    ffi.Pointer<ffi.Char> entryPath,
+  ) {
+    return _getZipEntryIndex(
+      zip,
+      entryPath,
+    );
+  }
+
+  late final _getZipEntryIndexPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int Function(ffi.Pointer<ffi.Void>,
+              ffi.Pointer<ffi.Char>)>>('getZipEntryIndex');
+  late final _getZipEntryIndex = _getZipEntryIndexPtr.asFunction<
+      int Function(ffi.Pointer<ffi.Void>, ffi.Pointer<ffi.Char>)>();
+
   int readZipFileEntry(
     ffi.Pointer<ffi.Void> zipEntryFile,
     ffi.Pointer<ffi.Int8> buf,
@@ -450,6 +501,29 @@ class NativeZipBindings {
   late final _readZipFileEntry = _readZipFileEntryPtr.asFunction<
       int Function(ffi.Pointer<ffi.Void>, ffi.Pointer<ffi.Int8>, int)>();
 
+  int readZipFileEntrySeek(
+    ffi.Pointer<ffi.Void> zip,
+    int index,
+    int offset,
+    ffi.Pointer<ffi.Int8> buf,
+    int len,
+  ) {
+    return _readZipFileEntrySeek(
+      zip,
+      index,
+      offset,
+      buf,
+      len,
+    );
+  }
+
+  late final _readZipFileEntrySeekPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int Function(ffi.Pointer<ffi.Void>, ffi.Int, ffi.Int64,
+              ffi.Pointer<ffi.Int8>, ffi.Int)>>('readZipFileEntrySeek');
+  late final _readZipFileEntrySeek = _readZipFileEntrySeekPtr.asFunction<
+      int Function(ffi.Pointer<ffi.Void>, int, int, ffi.Pointer<ffi.Int8>, int)>();
+
   int readZipFileEntryClose(
     ffi.Pointer<ffi.Void> zipEntryFile,
   ) {
@@ -516,6 +590,10 @@ final class NativeZipTaskProgressInfo extends ffi.Struct {
 
   @ffi.Size()
   external int processed_compressSize;
+
+  /// part of 'processed_fileSize' stored without compression
+  @ffi.Size()
+  external int stored_fileSize;
 }
 
 final class NativeZipTaskInfo extends ffi.Struct {
@@ -534,6 +612,49 @@ final class NativeZipTaskInfo extends ffi.Struct {
   external NativeZipTaskProgressInfo progress;
 }
 
+enum NativeZipFlags {
+  /// store files without compression if extension is .jpg, .mp4, .zip, ...
+  NZ_FLAG_STORE_BY_EXTENSION(1),
+
+  /// store files without compression if file starts with magic bytes of compressed format
+  NZ_FLAG_STORE_BY_MAGIC(2),
+
+  /// store files without compression if the first 64KB cannot be compressed
+  NZ_FLAG_STORE_BY_SAMPLE(4),
+  NZ_FLAG_STORE_BY_ALL(7),
+
+  /// skip files already in .zip with the same size and modified time, keep the compressed data of the entries
+  NZ_FLAG_SYNC(8),
+
+  /// with NZ_FLAG_SYNC, also compare crc of file content
+  NZ_FLAG_SYNC_CRC(16),
+
+  /// change count of active compress threads (at most 'threadCount') by measured throughput
+  NZ_FLAG_ADAPTIVE_THREADS(32),
+
+  /// compress blocks of large files independently and record them in .zip, so they can be extracted by threads
+  NZ_FLAG_BLOCK_INDEX(64),
+
+  /// unzip: drop data of large extracted files from page cache after written to disk
+  NZ_FLAG_NO_CACHE(128);
+
+  final int value;
+  const NativeZipFlags(this.value);
+
+  static NativeZipFlags fromValue(int value) => switch (value) {
+        1 => NZ_FLAG_STORE_BY_EXTENSION,
+        2 => NZ_FLAG_STORE_BY_MAGIC,
+        4 => NZ_FLAG_STORE_BY_SAMPLE,
+        7 => NZ_FLAG_STORE_BY_ALL,
+        8 => NZ_FLAG_SYNC,
+        16 => NZ_FLAG_SYNC_CRC,
+        32 => NZ_FLAG_ADAPTIVE_THREADS,
+        64 => NZ_FLAG_BLOCK_INDEX,
+        128 => NZ_FLAG_NO_CACHE,
+        _ => throw ArgumentError("Unknown value for NativeZipFlags: $value"),
+      };
+}
+
 /// --------------------------------------------------------------------------
 /// zip
 /// --------------------------------------------------------------------------
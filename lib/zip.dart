@@ -4,6 +4,58 @@ extension _CharPointer on Pointer<Char> {
   String toDartString() => cast<Utf8>().toDartString();
 }
 
+/// how to find files which are already compressed, e.g. .jpg, .mp4, .zip.
+/// these files are stored into .zip without compression, because compressing them costs a lot of CPU but saves nothing.
+/// values can be combined, e.g. `ZipStoreDetect.byExtension | ZipStoreDetect.byMagic`
+final class ZipStoreDetect {
+  /// always compress files
+  static const int none = 0;
+
+  /// by file extension, e.g. .jpg, .mp4, .zip, .apk
+  static const int byExtension = 1; // NativeZipFlags.NZ_FLAG_STORE_BY_EXTENSION
+
+  /// by magic bytes at the beginning of file
+  static const int byMagic = 2; // NativeZipFlags.NZ_FLAG_STORE_BY_MAGIC
+
+  /// by trial-compressing the first 64KB of file
+  static const int bySample = 4; // NativeZipFlags.NZ_FLAG_STORE_BY_SAMPLE
+
+  static const int all = byExtension | byMagic | bySample;
+}
+
+/// how [ZipFile.addFiles] handles files which are already in .zip
+enum ZipSyncMode {
+  /// always compress files again, and replace the existing entries
+  none,
+
+  /// skip files with the same size and modified time (2 seconds tolerance, precision of .zip) as the existing entries,
+  /// their compressed data in .zip are kept without compressing again
+  sizeAndTime,
+
+  /// same as [sizeAndTime], but also compare crc32 of file content, which reads all unchanged files once
+  crc;
+
+  /// values in [NativeZipFlags]
+  int get value => switch (this) {
+        none => 0,
+        sizeAndTime => NativeZipFlags.NZ_FLAG_SYNC.value,
+        crc => NativeZipFlags.NZ_FLAG_SYNC.value | NativeZipFlags.NZ_FLAG_SYNC_CRC.value,
+      };
+}
+
+/// compression method of files added into .zip
+enum ZipCompressMethod {
+  /// supported by all zip tools
+  deflate(8),
+
+  /// faster and better compression ratio than [deflate], but not supported by many zip tools.
+  /// native library must be built with `NATIVE_ZIP_ZSTD` cmake option
+  zstd(93);
+
+  final int value;
+  const ZipCompressMethod(this.value);
+}
+
 final class ZipEntryInfo {
   final ZipFile _zip;
 
@@ -28,8 +80,9 @@ final class ZipEntryInfo {
         compressedSize = e.compressedSize,
         modifiedUnixTime = e.modifiedTime;
 
-  Stream<List<int>> openRead() async* {
-    yield* _zip.openReadByIndex(index);
+  /// Refer to [ZipFile.openRead] for [start] and [end]
+  Stream<List<int>> openRead({int start = 0, int? end}) async* {
+    yield* _zip.openReadByIndex(index, start: start, end: end);
   }
 }
 
@@ -112,9 +165,23 @@ final class ZipFile {
 
   // --------
 
-  Stream<List<int>> openRead(String entryPath) async* {
+  /// Read content of file [entryPath] in .zip
+  ///
+  /// Like [File.openRead], only read from byte [start] (inclusive) to [end] (exclusive) if specified.
+  /// Seek in a compressed entry doesn't decompress it from the beginning each time:
+  /// checkpoints are recorded while the entry is decompressed the first time, and kept until the .zip is closed
+  Stream<List<int>> openRead(String entryPath, {int start = 0, int? end}) async* {
     _throwExceptionIf(true);
 
+    if (start != 0 || end != null) {
+      var s1 = entryPath.toNativeUtf8().cast<Char>();
+      int index = _bindings.getZipEntryIndex(_pZip, s1);
+      malloc.free(s1);
+      if (index < 0 || entryPath.endsWith('/')) throw ZipEntryOpenException();
+      yield* openReadByIndex(index, start: start, end: end);
+      return;
+    }
+
     var s1 = entryPath.toNativeUtf8().cast<Char>();
     var pFile = _bindings.readZipFileEntryOpen(_pZip, s1);
     malloc.free(s1);
@@ -122,8 +189,15 @@ final class ZipFile {
     yield* __openRead(pFile);
   }
 
-  Stream<List<int>> openReadByIndex(int entryIndex) async* {
+  Stream<List<int>> openReadByIndex(int entryIndex, {int start = 0, int? end}) async* {
     if (_isClosed) throw ZipFileClosedException();
+    if (start < 0 || (end != null && end < start)) {
+      throw ZipException(0, message: "invalid range: [$start, $end)");
+    }
+    if (start != 0 || end != null) {
+      yield* __openReadRange(entryIndex, start, end);
+      return;
+    }
 
     var pFile = _bindings.readZipFileEntryOpenByIndex(_pZip, entryIndex);
     if (pFile == nullptr) throw ZipEntryOpenException();
@@ -158,24 +232,57 @@ final class ZipFile {
     }
   }
 
+  Stream<List<int>> __openReadRange(int entryIndex, int start, int? end) async* {
+    const int bufSize = 1024 * 16;
+    Pointer<Int8>? pOutBuf;
+
+    _readWriteCount++;
+    try {
+      int pos = start;
+      while (end == null || pos < end) {
+        int len = (end == null || end - pos > bufSize) ? bufSize : end - pos;
+        pOutBuf = malloc<Int8>(len);
+        int outLen = _bindings.readZipFileEntrySeek(_pZip, entryIndex, pos, pOutBuf, len);
+        if (outLen > 0) {
+          yield pOutBuf.asTypedList(outLen, finalizer: malloc.nativeFree);
+          pOutBuf = null;
+          pos += outLen;
+        } else if (outLen == 0) {
+          break;
+        } else {
+          if (_isClosed) throw ZipFileClosedException();
+          throw ZipEntryReadException(outLen);
+        }
+      }
+    } finally {
+      if (pOutBuf != null) malloc.free(pOutBuf);
+      _readWriteCount--;
+    }
+  }
+
   /// Copy files from .zip to disk, with multi-thread support
   ///
   /// if [entryPath] is a file, save file to folder [outDirPath]
   ///
   /// if [entryPath] is a directory, recursively save the directory to folder [outDirPath]
   ///
-  /// [threadCount] default set to [Platform.numberOfProcessors]. In other words, use 100% of CPU
+  /// [threadCount] default is the number of CPUs this process can use (CPU affinity and container CPU quota are respected). In other words, use 100% of CPU
+  ///
+  /// If [noCache] is true, data of large files (8MB or more) are dropped from OS page cache after written to disk,
+  /// so extracting a huge .zip doesn't evict page cache used by other processes. Supported on Linux, Android and macOS
   ///
   /// Example: saveFilesTo(["prefix/dirA/"], "C:\\dirB\\") copy all files in 'prefix/dirA/*' in .zip to 'C:\\dirB\\dirA\\*' in disk
   ZipTaskFuture saveTo(
     String entryPath,
     String outDirPath, {
     int threadCount = 0,
+    bool noCache = false,
   }) {
     return saveFilesTo(
       <String>[entryPath],
       outDirPath,
       threadCount: threadCount,
+      noCache: noCache,
     );
   }
 
@@ -188,6 +295,7 @@ final class ZipFile {
     List<String> entryPaths,
     String outDirPath, {
     int threadCount = 0,
+    bool noCache = false,
   }) {
     _throwExceptionIf(true);
 
@@ -195,7 +303,7 @@ final class ZipFile {
       if (Platform.isAndroid || Platform.isIOS) {
         threadCount = (Platform.numberOfProcessors / 2).toInt();
       } else {
-        threadCount = Platform.numberOfProcessors;
+        threadCount = 0; // decided by native side, CPU affinity and cgroup CPU quota are respected
       }
     }
     if (entryPaths.isEmpty) {
@@ -220,7 +328,8 @@ final class ZipFile {
     var s2 = _zipFilePath.toNativeUtf8().cast<Char>();
     var s3 = outDirPath.toNativeUtf8().cast<Char>();
     var task = _bindings
-        .unzipToDirAsync(_pZip, s1, s2, nativeArr, count, s3, threadCount)
+        .unzipToDirAsync(_pZip, s1, s2, nativeArr, count, s3, threadCount,
+            noCache ? NativeZipFlags.NZ_FLAG_NO_CACHE.value : 0)
         .cast<NativeZipTaskInfo>();
 
     final completer = Completer<void>();
@@ -263,13 +372,47 @@ final class ZipFile {
   ///
   /// [zipEntryDirPath] set to empty string "" represents root directory.
   ///
-  /// [threadCount] default set to [Platform.numberOfProcessors]. In other words, use 100% of CPU
+  /// [threadCount] default is the number of CPUs this process can use (CPU affinity and container CPU quota are respected). In other words, use 100% of CPU
+  ///
+  /// Each file is divided into blocks of at most [maxBlockSize] bytes, which are compressed by threads,
+  /// and blocks in memory never exceed [maxMemoryUsage] bytes.
+  /// 0 means auto, decided by [threadCount] and available physical memory.
+  /// [maxBlockSize] cannot be larger than [maxMemoryUsage]
+  ///
+  /// [storeDetect] decides how to find already compressed files, which are stored without compression, see [ZipStoreDetect]
+  ///
+  /// [compressMethod] default is [ZipCompressMethod.deflate]
+  ///
+  /// [sync] decides whether to skip files not modified since they were added into .zip, see [ZipSyncMode]
+  ///
+  /// If [adaptiveThreadCount] is true, count of working threads (at most [threadCount]) changes by measured throughput,
+  /// e.g. less threads when disk is the bottleneck or CPUs are busy with other processes
+  ///
+  /// If [blockIndex] is true, blocks of large files are compressed independently (slightly lower compression ratio),
+  /// and their offsets are recorded in .zip, so [NativeZip.unzipToDir] can extract a large file by all threads.
+  /// Other zip tools just ignore it. Only works when creating a new .zip without password
   ZipTaskFuture addFile(String dirPath, String zipEntryDirPath,
-      {int compressLevel = 5, bool skipTopLevel = false, int threadCount = 0}) {
+      {int compressLevel = 5,
+      ZipCompressMethod compressMethod = ZipCompressMethod.deflate,
+      bool skipTopLevel = false,
+      int threadCount = 0,
+      int maxBlockSize = 0,
+      int maxMemoryUsage = 0,
+      int storeDetect = ZipStoreDetect.all,
+      ZipSyncMode sync = ZipSyncMode.none,
+      bool adaptiveThreadCount = false,
+      bool blockIndex = false}) {
     return addFiles(<String>[dirPath], zipEntryDirPath,
         compressLevel: compressLevel,
+        compressMethod: compressMethod,
         skipTopLevel: skipTopLevel,
-        threadCount: threadCount);
+        threadCount: threadCount,
+        maxBlockSize: maxBlockSize,
+        maxMemoryUsage: maxMemoryUsage,
+        storeDetect: storeDetect,
+        sync: sync,
+        adaptiveThreadCount: adaptiveThreadCount,
+        blockIndex: blockIndex);
   }
 
   /// Add files from disk to .zip, with multi-thread support
@@ -278,21 +421,40 @@ final class ZipFile {
   ///
   /// Refer to [addFile] document for details.
   ///
+  /// If files in [dirPaths] are mapped to the same entry path, only the first one is added, the others are skipped and logged
+  ///
   /// Example: addFiles(["c:\\dirA\\", "prefix/dirB"]) add all files in 'c:\\dirA\\*' in disk to 'prefx/dirB/dirA/*' in .zip
   ZipTaskFuture addFiles(List<String> dirPaths, String zipEntryDirPath,
-      {int compressLevel = 5, bool skipTopLevel = false, int threadCount = 0}) {
+      {int compressLevel = 5,
+      ZipCompressMethod compressMethod = ZipCompressMethod.deflate,
+      bool skipTopLevel = false,
+      int threadCount = 0,
+      int maxBlockSize = 0,
+      int maxMemoryUsage = 0,
+      int storeDetect = ZipStoreDetect.all,
+      ZipSyncMode sync = ZipSyncMode.none,
+      bool adaptiveThreadCount = false,
+      bool blockIndex = false}) {
     _throwExceptionIf(false);
 
     if (threadCount < 1 || threadCount > Platform.numberOfProcessors) {
       if (Platform.isAndroid || Platform.isIOS) {
         threadCount = (Platform.numberOfProcessors / 2).toInt();
       } else {
-        threadCount = Platform.numberOfProcessors;
+        threadCount = 0; // decided by native side, CPU affinity and cgroup CPU quota are respected
       }
     }
     if (compressLevel < 0 || compressLevel > 9) {
       throw ZipException(0, message: "argument [compressLevel] must be 0~9");
     }
+    if (maxBlockSize < 0 || maxMemoryUsage < 0) {
+      throw ZipException(0,
+          message: "argument [maxBlockSize] and [maxMemoryUsage] cannot be negative");
+    }
+    if (maxBlockSize > 0 && maxMemoryUsage > 0 && maxBlockSize > maxMemoryUsage) {
+      throw ZipException(0,
+          message: "argument [maxBlockSize] cannot be larger than [maxMemoryUsage]");
+    }
     if (dirPaths.isEmpty) {
       throw ZipFileInvalidPathException("argument [dirPaths] must not empty");
     }
@@ -318,9 +480,26 @@ final class ZipFile {
     }
 
     var s1 = zipEntryDirPath.toNativeUtf8().cast<Char>();
+    var s2 = _zipFilePath.toNativeUtf8().cast<Char>();
+    var s3 = _password?.toNativeUtf8().cast<Char>() ?? nullptr;
     var task = _bindings
-        .zipDirAsync(_pZip, _password != null ? true : false, nativeArr, count,
-            s1, compressLevel, skipTopLevel ? 1 : 0, threadCount)
+        .zipDirAsync(
+            _pZip,
+            s2,
+            s3,
+            nativeArr,
+            count,
+            s1,
+            compressLevel,
+            compressMethod.value,
+            skipTopLevel ? 1 : 0,
+            threadCount,
+            maxBlockSize,
+            maxMemoryUsage,
+            (storeDetect & ZipStoreDetect.all) |
+                sync.value |
+                (adaptiveThreadCount ? NativeZipFlags.NZ_FLAG_ADAPTIVE_THREADS.value : 0) |
+                (blockIndex ? NativeZipFlags.NZ_FLAG_BLOCK_INDEX.value : 0))
         .cast<NativeZipTaskInfo>();
 
     final completer = Completer<void>();
@@ -338,6 +517,8 @@ final class ZipFile {
 
       // cleanup after task done
       malloc.free(s1);
+      malloc.free(s2);
+      if (s3 != nullptr) malloc.free(s3);
       for (int i = 0; i < count; i++) {
         malloc.free(nativeArr[i++]);
       }
@@ -514,6 +695,10 @@ class ZipTaskFuture implements Future<void> {
   /// now processed (compressed) file size
   int get compressedSize => _task?.ref.progress.processed_compressSize ?? 0;
 
+  /// part of [processedSize] stored without compression, see [ZipStoreDetect].
+  /// the remaining part (processedSize - storedSize) is deflated
+  int get storedSize => _task?.ref.progress.stored_fileSize ?? 0;
+
   /// now processing file path
   String get nowProcessingFilepath {
     try {
@@ -0,0 +1,382 @@
+#include "my_aes.h"
+#include "my_sha1.h"
+
+#include <string.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MY_AES_X86
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define MY_AES_ARM
+#endif
+
+// XOR keystream of [blockCount] counter blocks into [data], counter of the first block is [ctr]
+typedef void (*_my_aes_ctr_func)(const MyAesKey* key, uint64_t ctr, uint8_t* data, size_t blockCount);
+
+static const uint8_t _my_aes_sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static const uint32_t _my_aes_te0[256] = {
+    0xc66363a5U, 0xf87c7c84U, 0xee777799U, 0xf67b7b8dU, 0xfff2f20dU, 0xd66b6bbdU, 0xde6f6fb1U, 0x91c5c554U,
+    0x60303050U, 0x02010103U, 0xce6767a9U, 0x562b2b7dU, 0xe7fefe19U, 0xb5d7d762U, 0x4dababe6U, 0xec76769aU,
+    0x8fcaca45U, 0x1f82829dU, 0x89c9c940U, 0xfa7d7d87U, 0xeffafa15U, 0xb25959ebU, 0x8e4747c9U, 0xfbf0f00bU,
+    0x41adadecU, 0xb3d4d467U, 0x5fa2a2fdU, 0x45afafeaU, 0x239c9cbfU, 0x53a4a4f7U, 0xe4727296U, 0x9bc0c05bU,
+    0x75b7b7c2U, 0xe1fdfd1cU, 0x3d9393aeU, 0x4c26266aU, 0x6c36365aU, 0x7e3f3f41U, 0xf5f7f702U, 0x83cccc4fU,
+    0x6834345cU, 0x51a5a5f4U, 0xd1e5e534U, 0xf9f1f108U, 0xe2717193U, 0xabd8d873U, 0x62313153U, 0x2a15153fU,
+    0x0804040cU, 0x95c7c752U, 0x46232365U, 0x9dc3c35eU, 0x30181828U, 0x379696a1U, 0x0a05050fU, 0x2f9a9ab5U,
+    0x0e070709U, 0x24121236U, 0x1b80809bU, 0xdfe2e23dU, 0xcdebeb26U, 0x4e272769U, 0x7fb2b2cdU, 0xea75759fU,
+    0x1209091bU, 0x1d83839eU, 0x582c2c74U, 0x341a1a2eU, 0x361b1b2dU, 0xdc6e6eb2U, 0xb45a5aeeU, 0x5ba0a0fbU,
+    0xa45252f6U, 0x763b3b4dU, 0xb7d6d661U, 0x7db3b3ceU, 0x5229297bU, 0xdde3e33eU, 0x5e2f2f71U, 0x13848497U,
+    0xa65353f5U, 0xb9d1d168U, 0x00000000U, 0xc1eded2cU, 0x40202060U, 0xe3fcfc1fU, 0x79b1b1c8U, 0xb65b5bedU,
+    0xd46a6abeU, 0x8dcbcb46U, 0x67bebed9U, 0x7239394bU, 0x944a4adeU, 0x984c4cd4U, 0xb05858e8U, 0x85cfcf4aU,
+    0xbbd0d06bU, 0xc5efef2aU, 0x4faaaae5U, 0xedfbfb16U, 0x864343c5U, 0x9a4d4dd7U, 0x66333355U, 0x11858594U,
+    0x8a4545cfU, 0xe9f9f910U, 0x04020206U, 0xfe7f7f81U, 0xa05050f0U, 0x783c3c44U, 0x259f9fbaU, 0x4ba8a8e3U,
+    0xa25151f3U, 0x5da3a3feU, 0x804040c0U, 0x058f8f8aU, 0x3f9292adU, 0x219d9dbcU, 0x70383848U, 0xf1f5f504U,
+    0x63bcbcdfU, 0x77b6b6c1U, 0xafdada75U, 0x42212163U, 0x20101030U, 0xe5ffff1aU, 0xfdf3f30eU, 0xbfd2d26dU,
+    0x81cdcd4cU, 0x180c0c14U, 0x26131335U, 0xc3ecec2fU, 0xbe5f5fe1U, 0x359797a2U, 0x884444ccU, 0x2e171739U,
+    0x93c4c457U, 0x55a7a7f2U, 0xfc7e7e82U, 0x7a3d3d47U, 0xc86464acU, 0xba5d5de7U, 0x3219192bU, 0xe6737395U,
+    0xc06060a0U, 0x19818198U, 0x9e4f4fd1U, 0xa3dcdc7fU, 0x44222266U, 0x542a2a7eU, 0x3b9090abU, 0x0b888883U,
+    0x8c4646caU, 0xc7eeee29U, 0x6bb8b8d3U, 0x2814143cU, 0xa7dede79U, 0xbc5e5ee2U, 0x160b0b1dU, 0xaddbdb76U,
+    0xdbe0e03bU, 0x64323256U, 0x743a3a4eU, 0x140a0a1eU, 0x924949dbU, 0x0c06060aU, 0x4824246cU, 0xb85c5ce4U,
+    0x9fc2c25dU, 0xbdd3d36eU, 0x43acacefU, 0xc46262a6U, 0x399191a8U, 0x319595a4U, 0xd3e4e437U, 0xf279798bU,
+    0xd5e7e732U, 0x8bc8c843U, 0x6e373759U, 0xda6d6db7U, 0x018d8d8cU, 0xb1d5d564U, 0x9c4e4ed2U, 0x49a9a9e0U,
+    0xd86c6cb4U, 0xac5656faU, 0xf3f4f407U, 0xcfeaea25U, 0xca6565afU, 0xf47a7a8eU, 0x47aeaee9U, 0x10080818U,
+    0x6fbabad5U, 0xf0787888U, 0x4a25256fU, 0x5c2e2e72U, 0x381c1c24U, 0x57a6a6f1U, 0x73b4b4c7U, 0x97c6c651U,
+    0xcbe8e823U, 0xa1dddd7cU, 0xe874749cU, 0x3e1f1f21U, 0x964b4bddU, 0x61bdbddcU, 0x0d8b8b86U, 0x0f8a8a85U,
+    0xe0707090U, 0x7c3e3e42U, 0x71b5b5c4U, 0xcc6666aaU, 0x904848d8U, 0x06030305U, 0xf7f6f601U, 0x1c0e0e12U,
+    0xc26161a3U, 0x6a35355fU, 0xae5757f9U, 0x69b9b9d0U, 0x17868691U, 0x99c1c158U, 0x3a1d1d27U, 0x279e9eb9U,
+    0xd9e1e138U, 0xebf8f813U, 0x2b9898b3U, 0x22111133U, 0xd26969bbU, 0xa9d9d970U, 0x078e8e89U, 0x339494a7U,
+    0x2d9b9bb6U, 0x3c1e1e22U, 0x15878792U, 0xc9e9e920U, 0x87cece49U, 0xaa5555ffU, 0x50282878U, 0xa5dfdf7aU,
+    0x038c8c8fU, 0x59a1a1f8U, 0x09898980U, 0x1a0d0d17U, 0x65bfbfdaU, 0xd7e6e631U, 0x844242c6U, 0xd06868b8U,
+    0x824141c3U, 0x299999b0U, 0x5a2d2d77U, 0x1e0f0f11U, 0x7bb0b0cbU, 0xa85454fcU, 0x6dbbbbd6U, 0x2c16163aU,
+};
+
+#define GETU32(p) (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+#define ROTR32(v, n) (((v) >> (n)) | ((v) << (32 - (n))))
+#define TE0(x) _my_aes_te0[(x) & 0xff]
+#define TE1(x) ROTR32(_my_aes_te0[(x) & 0xff], 8)
+#define TE2(x) ROTR32(_my_aes_te0[(x) & 0xff], 16)
+#define TE3(x) ROTR32(_my_aes_te0[(x) & 0xff], 24)
+#define SBOX(x) ((uint32_t)_my_aes_sbox[(x) & 0xff])
+
+void my_aes256_set_key(MyAesKey* key, const uint8_t k[32]) {
+    uint32_t* rk = key->rk;
+    uint32_t rcon = 0x01;
+    for (int i = 0; i < 8; i++) rk[i] = GETU32(k + i * 4);
+    for (int i = 8; i < 60; i++) {
+        uint32_t t = rk[i - 1];
+        if (i % 8 == 0) {
+            t = (SBOX(t >> 16) << 24) | (SBOX(t >> 8) << 16) | (SBOX(t) << 8) | SBOX(t >> 24); // SubWord(RotWord(t))
+            t ^= rcon << 24;
+            rcon = (rcon << 1) ^ ((rcon & 0x80) ? 0x1b : 0);
+        }
+        else if (i % 8 == 4) {
+            t = (SBOX(t >> 24) << 24) | (SBOX(t >> 16) << 16) | (SBOX(t >> 8) << 8) | SBOX(t);
+        }
+        rk[i] = rk[i - 8] ^ t;
+    }
+    for (int i = 0; i < 60; i++) {
+        key->rkBytes[i * 4] = (uint8_t)(rk[i] >> 24);
+        key->rkBytes[i * 4 + 1] = (uint8_t)(rk[i] >> 16);
+        key->rkBytes[i * 4 + 2] = (uint8_t)(rk[i] >> 8);
+        key->rkBytes[i * 4 + 3] = (uint8_t)rk[i];
+    }
+}
+
+static void _my_aes256_encrypt_block(const MyAesKey* key, const uint8_t in[16], uint8_t out[16]) {
+    const uint32_t* rk = key->rk;
+    uint32_t s0 = GETU32(in) ^ rk[0];
+    uint32_t s1 = GETU32(in + 4) ^ rk[1];
+    uint32_t s2 = GETU32(in + 8) ^ rk[2];
+    uint32_t s3 = GETU32(in + 12) ^ rk[3];
+    uint32_t t0, t1, t2, t3;
+    for (int round = 1; round < 14; round++) {
+        rk += 4;
+        t0 = TE0(s0 >> 24) ^ TE1(s1 >> 16) ^ TE2(s2 >> 8) ^ TE3(s3) ^ rk[0];
+        t1 = TE0(s1 >> 24) ^ TE1(s2 >> 16) ^ TE2(s3 >> 8) ^ TE3(s0) ^ rk[1];
+        t2 = TE0(s2 >> 24) ^ TE1(s3 >> 16) ^ TE2(s0 >> 8) ^ TE3(s1) ^ rk[2];
+        t3 = TE0(s3 >> 24) ^ TE1(s0 >> 16) ^ TE2(s1 >> 8) ^ TE3(s2) ^ rk[3];
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
+
+    // last round without MixColumns
+    rk += 4;
+    t0 = (SBOX(s0 >> 24) << 24) ^ (SBOX(s1 >> 16) << 16) ^ (SBOX(s2 >> 8) << 8) ^ SBOX(s3) ^ rk[0];
+    t1 = (SBOX(s1 >> 24) << 24) ^ (SBOX(s2 >> 16) << 16) ^ (SBOX(s3 >> 8) << 8) ^ SBOX(s0) ^ rk[1];
+    t2 = (SBOX(s2 >> 24) << 24) ^ (SBOX(s3 >> 16) << 16) ^ (SBOX(s0 >> 8) << 8) ^ SBOX(s1) ^ rk[2];
+    t3 = (SBOX(s3 >> 24) << 24) ^ (SBOX(s0 >> 16) << 16) ^ (SBOX(s1 >> 8) << 8) ^ SBOX(s2) ^ rk[3];
+    uint32_t t[4] = { t0, t1, t2, t3 };
+    for (int i = 0; i < 4; i++) {
+        out[i * 4] = (uint8_t)(t[i] >> 24);
+        out[i * 4 + 1] = (uint8_t)(t[i] >> 16);
+        out[i * 4 + 2] = (uint8_t)(t[i] >> 8);
+        out[i * 4 + 3] = (uint8_t)t[i];
+    }
+}
+
+static void _my_aes_counter_block(uint64_t ctr, uint8_t block[16]) {
+    // 128-bit little-endian counter, high 64 bits are always 0 for 64-bit offset
+    memset(block, 0, 16);
+    for (int i = 0; i < 8; i++) block[i] = (uint8_t)(ctr >> (i * 8));
+}
+
+static void _my_aes_ctr_table(const MyAesKey* key, uint64_t ctr, uint8_t* data, size_t blockCount) {
+    uint8_t counter[16];
+    uint8_t stream[16];
+    for (size_t i = 0; i < blockCount; i++, ctr++, data += 16) {
+        _my_aes_counter_block(ctr, counter);
+        _my_aes256_encrypt_block(key, counter, stream);
+        for (int j = 0; j < 16; j++) data[j] ^= stream[j];
+    }
+}
+
+// --------------------------------------------------------------------------
+// x86: AES-NI, 4 counter blocks in parallel to hide latency of AESENC
+// --------------------------------------------------------------------------
+
+#ifdef MY_AES_X86
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MY_TARGET_AESNI
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define MY_TARGET_AESNI __attribute__((target("aes,sse2")))
+#endif
+
+static bool _my_aes_x86_supported() {
+    unsigned int ecx = 0;
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    ecx = (unsigned int) info[2];
+#else
+    unsigned int eax, ebx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+#endif
+    return (ecx & (1u << 25)) != 0; // AES-NI
+}
+
+MY_TARGET_AESNI
+static void _my_aes_ctr_aesni(const MyAesKey* key, uint64_t ctr, uint8_t* data, size_t blockCount) {
+    __m128i rk[15];
+    for (int i = 0; i < 15; i++) rk[i] = _mm_loadu_si128((const __m128i*) (key->rkBytes + i * 16));
+
+    while (blockCount >= 4) {
+        __m128i b0 = _mm_xor_si128(_mm_set_epi64x(0, (long long) ctr), rk[0]);
+        __m128i b1 = _mm_xor_si128(_mm_set_epi64x(0, (long long) (ctr + 1)), rk[0]);
+        __m128i b2 = _mm_xor_si128(_mm_set_epi64x(0, (long long) (ctr + 2)), rk[0]);
+        __m128i b3 = _mm_xor_si128(_mm_set_epi64x(0, (long long) (ctr + 3)), rk[0]);
+        for (int i = 1; i < 14; i++) {
+            b0 = _mm_aesenc_si128(b0, rk[i]);
+            b1 = _mm_aesenc_si128(b1, rk[i]);
+            b2 = _mm_aesenc_si128(b2, rk[i]);
+            b3 = _mm_aesenc_si128(b3, rk[i]);
+        }
+        b0 = _mm_aesenclast_si128(b0, rk[14]);
+        b1 = _mm_aesenclast_si128(b1, rk[14]);
+        b2 = _mm_aesenclast_si128(b2, rk[14]);
+        b3 = _mm_aesenclast_si128(b3, rk[14]);
+        _mm_storeu_si128((__m128i*) data, _mm_xor_si128(b0, _mm_loadu_si128((const __m128i*) data)));
+        _mm_storeu_si128((__m128i*) (data + 16), _mm_xor_si128(b1, _mm_loadu_si128((const __m128i*) (data + 16))));
+        _mm_storeu_si128((__m128i*) (data + 32), _mm_xor_si128(b2, _mm_loadu_si128((const __m128i*) (data + 32))));
+        _mm_storeu_si128((__m128i*) (data + 48), _mm_xor_si128(b3, _mm_loadu_si128((const __m128i*) (data + 48))));
+        ctr += 4;
+        data += 64;
+        blockCount -= 4;
+    }
+    for (; blockCount > 0; blockCount--, ctr++, data += 16) {
+        __m128i b = _mm_xor_si128(_mm_set_epi64x(0, (long long) ctr), rk[0]);
+        for (int i = 1; i < 14; i++) b = _mm_aesenc_si128(b, rk[i]);
+        b = _mm_aesenclast_si128(b, rk[14]);
+        _mm_storeu_si128((__m128i*) data, _mm_xor_si128(b, _mm_loadu_si128((const __m128i*) data)));
+    }
+}
+
+#endif // MY_AES_X86
+
+// --------------------------------------------------------------------------
+// ARMv8: AES instructions
+// --------------------------------------------------------------------------
+
+#ifdef MY_AES_ARM
+
+#if defined(_MSC_VER)
+#include <arm64_neon.h>
+#include <windows.h>
+#define MY_TARGET_AES
+#else
+#include <arm_neon.h>
+#if defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO)
+#define MY_TARGET_AES
+#elif defined(__clang__)
+#define MY_TARGET_AES __attribute__((target("aes")))
+#else
+#define MY_TARGET_AES __attribute__((target("+crypto")))
+#endif
+#if defined(__linux__) || defined(__ANDROID__)
+#include <sys/auxv.h>
+#ifndef HWCAP_AES
+#define HWCAP_AES (1 << 3)
+#endif
+#endif
+#endif
+
+static bool _my_aes_arm_supported() {
+#if defined(_MSC_VER)
+    return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE);
+#elif defined(__APPLE__)
+    return true; // all Apple arm64 cpus
+#elif defined(__linux__) || defined(__ANDROID__)
+    return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#else
+    return false;
+#endif
+}
+
+MY_TARGET_AES
+static void _my_aes_ctr_armv8(const MyAesKey* key, uint64_t ctr, uint8_t* data, size_t blockCount) {
+    uint8x16_t rk[15];
+    for (int i = 0; i < 15; i++) rk[i] = vld1q_u8(key->rkBytes + i * 16);
+
+    uint8_t counter[16];
+    for (; blockCount > 0; blockCount--, ctr++, data += 16) {
+        _my_aes_counter_block(ctr, counter);
+        uint8x16_t b = vld1q_u8(counter);
+        for (int i = 0; i < 13; i++) b = vaesmcq_u8(vaeseq_u8(b, rk[i]));
+        b = veorq_u8(vaeseq_u8(b, rk[13]), rk[14]);
+        vst1q_u8(data, veorq_u8(b, vld1q_u8(data)));
+    }
+}
+
+#endif // MY_AES_ARM
+
+// --------------------------------------------------------------------------
+
+static _my_aes_ctr_func _my_aes_ctr_select() {
+#if defined(MY_AES_X86)
+    if (_my_aes_x86_supported()) return _my_aes_ctr_aesni;
+#elif defined(MY_AES_ARM)
+    if (_my_aes_arm_supported()) return _my_aes_ctr_armv8;
+#endif
+    return _my_aes_ctr_table;
+}
+
+static _my_aes_ctr_func volatile _my_aes_ctr_impl = NULL;
+
+void my_aes_winzip_ctr(const MyAesKey* key, uint64_t offset, void* _data, size_t len) {
+    // NOTE: may be selected by multiple threads at the same time, but they always select the same function
+    _my_aes_ctr_func func = _my_aes_ctr_impl;
+    if (func == NULL) {
+        func = _my_aes_ctr_select();
+        _my_aes_ctr_impl = func;
+    }
+
+    uint8_t* data = (uint8_t*)_data;
+    uint64_t ctr = offset / 16 + 1;
+    size_t skip = (size_t)(offset % 16);
+    uint8_t tmp[16];
+    if (skip > 0 && len > 0) { // [offset] is not aligned to AES block, e.g. compressed block with any size
+        size_t n = 16 - skip < len ? 16 - skip : len;
+        memset(tmp, 0, sizeof(tmp));
+        memcpy(tmp + skip, data, n);
+        func(key, ctr++, tmp, 1);
+        memcpy(data, tmp + skip, n);
+        data += n;
+        len -= n;
+    }
+
+    size_t blockCount = len / 16;
+    if (blockCount > 0) {
+        func(key, ctr, data, blockCount);
+        ctr += blockCount;
+        data += blockCount * 16;
+        len -= blockCount * 16;
+    }
+
+    if (len > 0) {
+        memset(tmp, 0, sizeof(tmp));
+        memcpy(tmp, data, len);
+        func(key, ctr, tmp, 1);
+        memcpy(data, tmp, len);
+    }
+}
+
+// --------------------------------------------------------------------------
+
+#define MY_WINZIP_AES_PBKDF2_ITERATIONS 1000
+
+int my_winzip_aes_init(MyWinzipAes* aes, const char* password) {
+    if (my_random_bytes(aes->salt, sizeof(aes->salt)) != 0) return -1;
+
+    // derived key: AES key (32 bytes) + HMAC key (32 bytes) + password verifier (2 bytes)
+    uint8_t derived[32 + 32 + MY_WINZIP_AES_VERIFIER_SIZE];
+    my_pbkdf2_sha1(password, strlen(password), aes->salt, sizeof(aes->salt), MY_WINZIP_AES_PBKDF2_ITERATIONS, derived, sizeof(derived));
+    my_aes256_set_key(&aes->key, derived);
+    memcpy(aes->hmacKey, derived + 32, 32);
+    memcpy(aes->verifier, derived + 64, MY_WINZIP_AES_VERIFIER_SIZE);
+    memset(derived, 0, sizeof(derived));
+    return 0;
+}
+
+#if defined(_WIN32)
+#include <windows.h>
+#define RtlGenRandom SystemFunction036
+BOOLEAN NTAPI RtlGenRandom(PVOID buffer, ULONG length);
+#ifdef _MSC_VER
+#pragma comment(lib, "advapi32.lib")
+#endif
+#elif defined(__APPLE__)
+#include <stdlib.h> // arc4random_buf()
+#else
+#include <stdio.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <errno.h>
+#endif
+#endif
+
+int my_random_bytes(void* buf, size_t len) {
+#if defined(_WIN32)
+    return RtlGenRandom(buf, (ULONG)len) ? 0 : -1;
+#elif defined(__APPLE__)
+    arc4random_buf(buf, len);
+    return 0;
+#else
+#if defined(__linux__) && defined(SYS_getrandom)
+    uint8_t* p = (uint8_t*)buf;
+    size_t left = len;
+    while (left > 0) {
+        long n = syscall(SYS_getrandom, p, left, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break; // e.g. ENOSYS on old kernel, use /dev/urandom instead
+        p += n;
+        left -= (size_t)n;
+    }
+    if (left == 0) return 0;
+#endif
+    FILE* fp = fopen("/dev/urandom", "rb");
+    if (fp == NULL) return -1;
+    size_t readLen = fread(buf, 1, len, fp);
+    fclose(fp);
+    return readLen == len ? 0 : -1;
+#endif
+}
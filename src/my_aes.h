@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+
+// AES-256 encryption only, used by WinZip AES (CTR mode never needs decryption of AES blocks)
+typedef struct MyAesKey {
+    uint32_t rk[60]; // round keys, big-endian words
+    uint8_t rkBytes[240]; // the same round keys in bytes, for AES instructions
+} MyAesKey;
+
+void my_aes256_set_key(MyAesKey* key, const uint8_t k[32]);
+
+// encrypt (or decrypt) data in WinZip AES CTR mode: 128-bit little-endian counter, starts from 1
+// [offset] is position of [data] in the whole encrypted data of the entry, so blocks can be encrypted in any thread
+// use AES-NI (x86) / ARMv8 AES instructions if cpu supports, or fallback to table-based implementation
+void my_aes_winzip_ctr(const MyAesKey* key, uint64_t offset, void* data, size_t len);
+
+// --------------------------------------------------------------------------
+// WinZip AE-1 / AE-2 (AES-256)
+// ref: https://www.winzip.com/en/support/aes-encryption/
+// --------------------------------------------------------------------------
+
+#define MY_WINZIP_AES_SALT_SIZE 16
+#define MY_WINZIP_AES_VERIFIER_SIZE 2
+#define MY_WINZIP_AES_MAC_SIZE 10
+#define MY_WINZIP_AES_OVERHEAD (MY_WINZIP_AES_SALT_SIZE + MY_WINZIP_AES_VERIFIER_SIZE + MY_WINZIP_AES_MAC_SIZE)
+
+typedef struct MyWinzipAes {
+    MyAesKey key;
+    uint8_t hmacKey[32];
+    uint8_t salt[MY_WINZIP_AES_SALT_SIZE];
+    uint8_t verifier[MY_WINZIP_AES_VERIFIER_SIZE];
+} MyWinzipAes;
+
+// generate random salt, and derive keys from [password], return 0 if success
+int my_winzip_aes_init(MyWinzipAes* aes, const char* password);
+
+// fill [buf] with cryptographically secure random bytes, return 0 if success
+int my_random_bytes(void* buf, size_t len);
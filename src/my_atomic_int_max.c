@@ -27,6 +27,18 @@ void atomic_int_max_add(atomic_int_max_t* ai, size_t n) {
     thd_mutex_unlock(&ai->mutex);
 }
 
+// same as atomic_int_max_add(), but return 0 instead of waiting if exceeds 'max_value'
+int atomic_int_max_try_add(atomic_int_max_t* ai, size_t n) {
+    int ret = 0;
+    thd_mutex_lock(&ai->mutex);
+    if (ai->isInvalid || ai->value + n <= ai->max_value) {
+        ai->value += n;
+        ret = 1;
+    }
+    thd_mutex_unlock(&ai->mutex);
+    return ret;
+}
+
 void atomic_int_max_sub(atomic_int_max_t* ai, size_t n) {
     thd_mutex_lock(&ai->mutex);
     ai->value -= n;
@@ -0,0 +1,101 @@
+#include "my_buffer_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h> // NULL
+#include <stdbool.h> // bool
+
+#define BUFFER_POOL_MIN_SIZE (1024 * 4)
+#define BUFFER_POOL_HEADER_SIZE ((sizeof(_buffer_pool_header) + 15) & ~(size_t)15) // keep buffer 16-bytes aligned
+
+// get the size class of [size], and the real buffer size of this class
+static size_t _buffer_pool_class(size_t size, size_t* classSize) {
+    if (size < BUFFER_POOL_MIN_SIZE) size = BUFFER_POOL_MIN_SIZE;
+
+    size_t bits = 0; // 2^bits <= size - 1
+    while (((size - 1) >> (bits + 1)) != 0) bits++;
+    size_t step = ((size_t)1 << bits) / 4;
+    size_t k = (size - ((size_t)1 << bits) + step - 1) / step; // 1 ~ 4
+    *classSize = ((size_t)1 << bits) + k * step;
+    return bits * 4 + k - 1;
+}
+
+static size_t _buffer_pool_class_size(size_t classIndex) {
+    size_t bits = classIndex / 4;
+    return ((size_t)1 << bits) + (classIndex % 4 + 1) * (((size_t)1 << bits) / 4);
+}
+
+void buffer_pool_init(BufferPool* pool, size_t maxRetainedSize) {
+    memset(pool->freeList, 0, sizeof(pool->freeList));
+    pool->retainedSize = 0;
+    pool->maxRetainedSize = maxRetainedSize;
+    pool->usedCount = 0;
+    thd_mutex_init(&pool->mutex);
+}
+
+void buffer_pool_destroy(BufferPool* pool) {
+    for (int i = 0; i < BUFFER_POOL_CLASS_COUNT; i++) {
+        _buffer_pool_header* h = pool->freeList[i];
+        while (h) {
+            _buffer_pool_header* next = h->next;
+            free(h);
+            h = next;
+        }
+        pool->freeList[i] = NULL;
+    }
+    pool->retainedSize = 0;
+    thd_mutex_destroy(&pool->mutex);
+}
+
+void* buffer_pool_get(BufferPool* pool, size_t size) {
+    // return a buffer at least [size] bytes, reuse a free one if possible
+    size_t classSize;
+    size_t classIndex = _buffer_pool_class(size, &classSize);
+
+    thd_mutex_lock(&pool->mutex);
+    _buffer_pool_header* h = pool->freeList[classIndex];
+    if (h) {
+        pool->freeList[classIndex] = h->next;
+        pool->retainedSize -= classSize;
+    }
+    pool->usedCount++;
+    thd_mutex_unlock(&pool->mutex);
+
+    if (h == NULL) {
+        h = (_buffer_pool_header*)malloc(BUFFER_POOL_HEADER_SIZE + classSize);
+        if (h == NULL) {
+            thd_mutex_lock(&pool->mutex);
+            pool->usedCount--;
+            thd_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        h->classIndex = classIndex;
+    }
+    h->next = NULL;
+    return (char*)h + BUFFER_POOL_HEADER_SIZE;
+}
+
+void buffer_pool_put(BufferPool* pool, void* buf) {
+    if (!buf) return;
+    _buffer_pool_header* h = (_buffer_pool_header*)((char*)buf - BUFFER_POOL_HEADER_SIZE);
+    size_t classSize = _buffer_pool_class_size(h->classIndex);
+
+    thd_mutex_lock(&pool->mutex);
+    pool->usedCount--;
+    bool toKeep = pool->retainedSize + classSize <= pool->maxRetainedSize;
+    if (toKeep) {
+        h->next = pool->freeList[h->classIndex];
+        pool->freeList[h->classIndex] = h;
+        pool->retainedSize += classSize;
+    }
+    thd_mutex_unlock(&pool->mutex);
+
+    if (!toKeep) free(h);
+}
+
+size_t buffer_pool_used_count(BufferPool* pool) {
+    thd_mutex_lock(&pool->mutex);
+    size_t count = pool->usedCount;
+    thd_mutex_unlock(&pool->mutex);
+    return count;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h> // size_t
+#include "my_thread.h"
+
+// buffers are grouped by size class, 4 classes between each power of 2, e.g. 8M, 10M, 12M, 14M, 16M, ...
+#define BUFFER_POOL_CLASS_COUNT (64 * 4)
+
+typedef struct _buffer_pool_header { // placed before each buffer
+    struct _buffer_pool_header* next; // next free buffer in the same size class
+    size_t classIndex;
+} _buffer_pool_header;
+
+typedef struct BufferPool {
+    _buffer_pool_header* freeList[BUFFER_POOL_CLASS_COUNT];
+    size_t retainedSize; // total size of all free buffers kept in pool
+    size_t maxRetainedSize; // free buffers are released to system if 'retainedSize' exceeds this
+    size_t usedCount; // buffers got from pool but not put back yet
+    thd_mutex mutex;
+} BufferPool;
+
+
+void buffer_pool_init(BufferPool* pool, size_t maxRetainedSize);
+void buffer_pool_destroy(BufferPool* pool);
+void* buffer_pool_get(BufferPool* pool, size_t size);
+void buffer_pool_put(BufferPool* pool, void* buf);
+size_t buffer_pool_used_count(BufferPool* pool);
@@ -1,12 +1,28 @@
 #include <zlib.h>
+#include <zip.h>
 #include "my_compress.h"
 
+#ifdef NATIVE_ZIP_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
 #include <assert.h>
 #include <stdlib.h>
 
+typedef struct _my_zlib_stream {
+    z_stream zs;
+    int level;
+#ifdef NATIVE_ZIP_LIBDEFLATE
+    struct libdeflate_compressor* compressor; // allocated when first used by _my_zlib_compress_whole()
+#endif
+} _my_zlib_stream;
+
 void* _my_zlib_compress_init(int level) {
-	z_stream *pStream = (z_stream*) malloc(sizeof(z_stream));
-	if (pStream == NULL) return NULL;
+	_my_zlib_stream *s = (_my_zlib_stream*) calloc(1, sizeof(_my_zlib_stream));
+	if (s == NULL) return NULL;
+	s->level = level;
+
+	z_stream *pStream = &s->zs;
 
 	pStream->zalloc = NULL;
 	pStream->zfree = NULL;
@@ -16,11 +32,11 @@ void* _my_zlib_compress_init(int level) {
 	const int windowBits = -MAX_WBITS;
 	int err = deflateInit2(pStream, level, Z_DEFLATED, windowBits, memLevel, Z_DEFAULT_STRATEGY);
 	if (err != Z_OK) {
-		free(pStream);
+		free(s);
 		return NULL;
 	}
 
-	return pStream;
+	return s;
 }
 
 size_t _my_zlib_compress_next(void* stream, char *inBuf, size_t inBufLen, char *outBuf, size_t outBufSize, MY_FLUSH_TYPE flushState) {
@@ -28,7 +44,7 @@ size_t _my_zlib_compress_next(void* stream, char *inBuf, size_t inBufLen, char *
     // NOTE: we assume the input buffer size is small, and output buffer size is large enough
     //       so all the input buffer will be consumed before exit the function
 
-	z_stream* pStream = (z_stream*) stream;
+	z_stream* pStream = &((_my_zlib_stream*) stream)->zs;
 
     int flushMode = Z_NO_FLUSH;
     switch (flushState) {
@@ -56,11 +72,82 @@ size_t _my_zlib_compress_next(void* stream, char *inBuf, size_t inBufLen, char *
         assert(pStream->avail_in == 0);
         return outputLen;
     }
-    return err;
+    return MY_COMPRESS_ERROR;
 }
 
+// reuse the stream for next data, without free / allocate internal state again
+int _my_zlib_compress_reset(void* stream) {
+    return deflateReset(&((_my_zlib_stream*) stream)->zs);
+}
+
+// must be called before the first _my_zlib_compress_next() after init / reset
+int _my_zlib_compress_set_dictionary(void* stream, const char* dict, size_t dictLen) {
+    return deflateSetDictionary(&((_my_zlib_stream*) stream)->zs, (const Bytef*) dict, (uInt) dictLen);
+}
+
+#ifdef NATIVE_ZIP_LIBDEFLATE
+// compress the whole buffer into a complete raw deflate stream, for file fit in one block,
+// libdeflate is much faster than zlib when all the input is available at once
+// NOTE: without libdeflate, zlib gains nothing from it, so files are streamed by _my_zlib_compress_next() instead
+size_t _my_zlib_compress_whole(void* stream, const char* inBuf, size_t inBufLen, char* outBuf, size_t outBufSize) {
+    _my_zlib_stream* s = (_my_zlib_stream*) stream;
+
+    if (s->compressor == NULL) {
+        int level = s->level == Z_DEFAULT_COMPRESSION ? 6 : s->level;
+        s->compressor = libdeflate_alloc_compressor(level);
+    }
+    if (s->compressor != NULL) {
+        size_t outputLen = libdeflate_deflate_compress(s->compressor, inBuf, inBufLen, outBuf, outBufSize);
+        if (outputLen > 0) return outputLen;
+        // 0 means output buffer is too small, it may happen because libdeflate bound is different from zlib, try zlib
+    }
+
+    if (deflateReset(&s->zs) != Z_OK) return MY_COMPRESS_ERROR;
+    return _my_zlib_compress_next(stream, (char*) inBuf, inBufLen, outBuf, outBufSize, MY_FLUSH_FINISH);
+}
+#endif
+
 void _my_zlib_compress_destroy(void* stream) {
-	z_stream* pStream = (z_stream*) stream;
-	deflateEnd(pStream);
-	free(pStream);
-}
\ No newline at end of file
+	_my_zlib_stream* s = (_my_zlib_stream*) stream;
+	deflateEnd(&s->zs);
+#ifdef NATIVE_ZIP_LIBDEFLATE
+	if (s->compressor) libdeflate_free_compressor(s->compressor);
+#endif
+	free(s);
+}
+
+static size_t _my_zlib_compress_bound(size_t len) {
+    return compressBound((uLong) len);
+}
+
+// NOTE: raw deflate, each block ends with Z_SYNC_FLUSH, so all blocks of a file are one deflate stream
+static const MyCompressBackend _my_zlib_backend = {
+    ZIP_CM_DEFLATE,
+    _my_zlib_compress_init,
+    _my_zlib_compress_reset,
+    _my_zlib_compress_set_dictionary,
+    _my_zlib_compress_next,
+    _my_zlib_compress_bound,
+#ifdef NATIVE_ZIP_LIBDEFLATE
+    _my_zlib_compress_whole,
+#else
+    NULL,
+#endif
+    _my_zlib_compress_destroy,
+};
+
+#ifdef NATIVE_ZIP_ZSTD
+extern const MyCompressBackend _my_zstd_backend; // my_zstd.c
+#endif
+
+const MyCompressBackend* my_compress_get_backend(int method) {
+    switch (method) {
+    case ZIP_CM_DEFLATE:
+        return &_my_zlib_backend;
+#ifdef NATIVE_ZIP_ZSTD
+    case ZIP_CM_ZSTD:
+        return &_my_zstd_backend;
+#endif
+    }
+    return NULL;
+}
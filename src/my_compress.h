@@ -8,6 +8,26 @@ typedef enum {
     MY_FLUSH_FINISH = 2,  // end of file
 } MY_FLUSH_TYPE;
 
+#define MY_COMPRESS_ERROR ((size_t)-1) // returned by 'next()' if error occurs
+
+// a compression method used by compress threads in zipDir()
+// each block of a file is compressed by 'next()' after 'reset()', and the output of all blocks are concatenated
+typedef struct MyCompressBackend {
+    int method; // compression method in zip, ZIP_CM_DEFLATE, ZIP_CM_ZSTD, ...
+    void* (*init)(int level);
+    int (*reset)(void* stream); // return 0 if success
+    int (*set_dictionary)(void* stream, const char* dict, size_t dictLen); // NULL if data of previous block cannot be used by decoder
+    size_t (*next)(void* stream, char* inBuf, size_t inBufLen, char* outBuf, size_t outBufSize, MY_FLUSH_TYPE flushState);
+    size_t (*bound)(size_t len); // max output size of a block with [len] bytes
+    size_t (*compress)(void* stream, const char* inBuf, size_t inBufLen, char* outBuf, size_t outBufSize); // whole-buffer single-shot, for file fit in one block, NULL if not supported
+    void (*destroy)(void* stream);
+} MyCompressBackend;
+
+const MyCompressBackend* my_compress_get_backend(int method); // return NULL if [method] not supported
+
 void* _my_zlib_compress_init(int level);
 size_t _my_zlib_compress_next(void* stream, char* inBuf, size_t inBufLen, char* outBuf, size_t outBufSize, MY_FLUSH_TYPE flushState);
+int _my_zlib_compress_reset(void* stream);
+int _my_zlib_compress_set_dictionary(void* stream, const char* dict, size_t dictLen);
+size_t _my_zlib_compress_whole(void* stream, const char* inBuf, size_t inBufLen, char* outBuf, size_t outBufSize);
 void _my_zlib_compress_destroy(void* stream);
\ No newline at end of file
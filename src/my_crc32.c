@@ -0,0 +1,242 @@
+#include "my_crc32.h"
+
+#include <zlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MY_CRC32_X86
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define MY_CRC32_ARM
+#endif
+
+typedef uint32_t (*_my_crc32_func)(uint32_t crc, const unsigned char* buf, size_t len);
+
+static uint32_t _my_crc32_zlib(uint32_t crc, const unsigned char* buf, size_t len) {
+    while (len > 0) { // crc32() accepts uInt length only
+        uInt count = len > (1u << 30) ? (1u << 30) : (uInt) len;
+        crc = (uint32_t) crc32(crc, buf, count);
+        buf += count;
+        len -= count;
+    }
+    return crc;
+}
+
+// --------------------------------------------------------------------------
+// x86: fold 4x128 bits by PCLMULQDQ, then Barrett reduction (same as Chromium zlib crc32_simd.c)
+// --------------------------------------------------------------------------
+
+#ifdef MY_CRC32_X86
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MY_TARGET_PCLMUL
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define MY_TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#endif
+
+static bool _my_crc32_x86_supported() {
+    unsigned int ecx = 0;
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    ecx = (unsigned int) info[2];
+#else
+    unsigned int eax, ebx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+#endif
+    return (ecx & (1u << 1)) && (ecx & (1u << 19)); // PCLMULQDQ, SSE4.1
+}
+
+static const uint64_t _k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+static const uint64_t _k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+static const uint64_t _k5k0[] = { 0x0163cd6124, 0x0000000000 };
+static const uint64_t _poly[] = { 0x01db710641, 0x01f7011641 };
+
+// [len] must be >= 64 and multiple of 16, [crc] is not inverted
+MY_TARGET_PCLMUL
+static uint32_t _my_crc32_pclmul_fold(uint32_t crc, const unsigned char* buf, size_t len) {
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i*) (buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*) (buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*) (buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*) (buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+    x0 = _mm_loadu_si128((const __m128i*) _k1k2);
+    buf += 64;
+    len -= 64;
+
+    // fold 4 x 128 bits in parallel
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i*) (buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*) (buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*) (buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*) (buf + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        buf += 64;
+        len -= 64;
+    }
+
+    // fold into 128 bits
+    x0 = _mm_loadu_si128((const __m128i*) _k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // fold the remaining 128 bits blocks
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*) buf);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    // fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i*) _k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_loadu_si128((const __m128i*) _poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (uint32_t) _mm_extract_epi32(x1, 1);
+}
+
+static uint32_t _my_crc32_pclmul(uint32_t crc, const unsigned char* buf, size_t len) {
+    if (len >= 64) {
+        size_t chunkLen = len & ~(size_t) 15;
+        crc = ~_my_crc32_pclmul_fold(~crc, buf, chunkLen);
+        buf += chunkLen;
+        len -= chunkLen;
+    }
+    return len > 0 ? _my_crc32_zlib(crc, buf, len) : crc;
+}
+
+#endif // MY_CRC32_X86
+
+// --------------------------------------------------------------------------
+// ARMv8: CRC32 instructions (crc32 polynomial, not crc32c)
+// --------------------------------------------------------------------------
+
+#ifdef MY_CRC32_ARM
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <windows.h>
+#define MY_TARGET_CRC
+#else
+#include <arm_acle.h>
+#if defined(__ARM_FEATURE_CRC32)
+#define MY_TARGET_CRC
+#elif defined(__clang__)
+#define MY_TARGET_CRC __attribute__((target("crc")))
+#else
+#define MY_TARGET_CRC __attribute__((target("+crc")))
+#endif
+#if defined(__linux__) || defined(__ANDROID__)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+#endif
+
+static bool _my_crc32_arm_supported() {
+#if defined(_MSC_VER)
+    return IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE);
+#elif defined(__APPLE__)
+    return true; // all Apple arm64 cpus
+#elif defined(__linux__) || defined(__ANDROID__)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return false;
+#endif
+}
+
+MY_TARGET_CRC
+static uint32_t _my_crc32_armv8(uint32_t crc, const unsigned char* buf, size_t len) {
+    crc = ~crc;
+    while (len > 0 && ((uintptr_t) buf & 7)) {
+        crc = __crc32b(crc, *buf++);
+        len--;
+    }
+    while (len >= 32) {
+        uint64_t v[4];
+        memcpy(v, buf, sizeof(v));
+        crc = __crc32d(crc, v[0]);
+        crc = __crc32d(crc, v[1]);
+        crc = __crc32d(crc, v[2]);
+        crc = __crc32d(crc, v[3]);
+        buf += 32;
+        len -= 32;
+    }
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, buf, sizeof(v));
+        crc = __crc32d(crc, v);
+        buf += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = __crc32b(crc, *buf++);
+        len--;
+    }
+    return ~crc;
+}
+
+#endif // MY_CRC32_ARM
+
+// --------------------------------------------------------------------------
+
+static _my_crc32_func _my_crc32_select() {
+#if defined(MY_CRC32_X86)
+    if (_my_crc32_x86_supported()) return _my_crc32_pclmul;
+#elif defined(MY_CRC32_ARM)
+    if (_my_crc32_arm_supported()) return _my_crc32_armv8;
+#endif
+    return _my_crc32_zlib;
+}
+
+static _my_crc32_func volatile _my_crc32_impl = NULL;
+
+uint32_t my_crc32(uint32_t crc, const void* buf, size_t len) {
+    // NOTE: may be selected by multiple threads at the same time, but they always select the same function
+    _my_crc32_func func = _my_crc32_impl;
+    if (func == NULL) {
+        func = _my_crc32_select();
+        _my_crc32_impl = func;
+    }
+    return func(crc, (const unsigned char*) buf, len);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+
+// same as zlib crc32(), but use PCLMULQDQ (x86) / CRC32 instructions (ARMv8) if cpu supports,
+// or fallback to zlib crc32()
+// NOTE: blocks are still combined by zlib crc32_combine()
+uint32_t my_crc32(uint32_t crc, const void* buf, size_t len);
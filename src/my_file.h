@@ -5,6 +5,8 @@
 #include <sys/stat.h> // stat()
 #include <string.h> // strcpy_s()
 #include <stdbool.h> // bool
+#include <stdint.h> // int64_t
+#include <stdio.h> // FILE
 
 #define ZIP_PATH_SEPARATOR '/'
 #define MAX_PATH_CHAR_COUNT 1024*32
@@ -24,7 +26,7 @@ int _my_file_fopen_windows(FILE** fp, const char* path, WCHAR* mode); // windows
 #include <io.h> // _findfirst(), ...
 typedef HANDLE _NATIVE_DIR;
 typedef WIN32_FIND_DATA _NATIVE_FILE_INFO;
-typedef struct _stat NATIVE_FILE_STAT;
+typedef struct _stat64 NATIVE_FILE_STAT; // 64-bit st_size, files larger than 2GB
 #define DIR_SEPARATOR '\\'
 
 #define S_ISDIR(mode) (((mode) & _S_IFMT) == _S_IFDIR)
@@ -76,4 +78,47 @@ typedef int (*my_dir_traversal_cb)(const char* path, const char* relPath, NATIVE
 int my_dir_traversal(const char* path, const char* relPath, bool skipTopLevel, my_dir_traversal_cb cb, void* param);
 
 int my_file_set_lastWriteTime(const char* path, bool isDir, time_t mtime);
+int my_file_rename(const char* oldPath, const char* newPath);
+int my_file_remove(const char* path);
 
+// positioned read with 64-bit offset, without stdio buffer and file position,
+// so a file larger than 4GB can be read by blocks (even on 32-bit platforms), and one handle can be shared by threads
+#ifdef _WIN32
+typedef HANDLE MyFileHandle;
+#define MY_FILE_INVALID_HANDLE INVALID_HANDLE_VALUE
+#else
+typedef int MyFileHandle;
+#define MY_FILE_INVALID_HANDLE (-1)
+#endif
+
+MyFileHandle my_file_open_read(const char* path); // MY_FILE_INVALID_HANDLE if failed
+MyFileHandle my_file_open_read_shared(const char* path); // same as my_file_open_read(), but read by many threads at the same time
+int my_file_pread(MyFileHandle fd, void* buf, size_t len, uint64_t offset); // read exactly [len] bytes, return 0 if success
+MyFileHandle my_file_open_write(const char* path); // create or truncate, MY_FILE_INVALID_HANDLE if failed
+int my_file_pwrite(MyFileHandle fd, const void* buf, size_t len, uint64_t offset); // return 0 if all [len] bytes written
+void my_file_close(MyFileHandle fd);
+int my_file_fseek64(FILE* fp, int64_t offset, int origin); // same as fseek(), but with 64-bit offset
+MyFileHandle my_file_get_handle(FILE* fp);
+void my_file_preallocate(MyFileHandle fd, uint64_t size); // reserve disk space before writing, to reduce fragmentation. do nothing if not supported or not enough space
+int my_file_truncate(MyFileHandle fd, uint64_t size); // set file size, and release space reserved by my_file_preallocate() after it. return 0 if success
+void my_file_drop_cache(MyFileHandle fd, uint64_t offset, uint64_t len); // wait until written to disk and remove from page cache. do nothing if not supported
+
+// batched file I/O by io_uring (linux only, built with NATIVE_ZIP_IO_URING),
+// many reads / writes are submitted by one syscall and run in parallel
+typedef struct MyFileRing MyFileRing;
+typedef struct MyFileIoRequest {
+    int fd;
+    bool isWrite;
+    char* buf;
+    size_t len;
+    int64_t offset;
+    bool isFailed; // set by ring if failed
+} MyFileIoRequest;
+
+MyFileRing* my_file_ring_create(unsigned int queueDepth); // NULL if not supported, use stdio instead
+int my_file_ring_submit(MyFileRing* ring, MyFileIoRequest* reqs, int count); // 'reqs' and buffers must be kept until my_file_ring_wait()
+int my_file_ring_wait(MyFileRing* ring); // wait until all submitted requests done, return 0 if all bytes read / written
+int my_file_ring_wait_request(MyFileRing* ring, MyFileIoRequest* req); // wait until [req] done, return 0 if all bytes read / written, a failure is also returned by next my_file_ring_wait()
+int my_file_ring_register_buffer(MyFileRing* ring, void* buf, size_t len); // requests inside [buf] use pre-mapped pages (READ_FIXED / WRITE_FIXED), return 0 if success
+int my_file_ring_read_files(MyFileRing* ring, const char** paths, char** bufs, const size_t* lens, int count); // read the first [lens[i]] bytes of each file
+void my_file_ring_destroy(MyFileRing* ring);
@@ -31,9 +31,23 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #ifndef _WIN32
 
+#define _LARGEFILE64_SOURCE // pread64(), fseeko64() on 32-bit linux, without changing 'struct stat' like _FILE_OFFSET_BITS
+#define _GNU_SOURCE // fallocate(), sync_file_range()
+
 #include "my_file.h"
 #include "my_utils.h"
 #include <utime.h>
+#include <stdio.h> // rename()
+#include <fcntl.h> // open()
+#include <unistd.h> // close()
+#include <sys/mman.h> // mmap()
+#include <limits.h> // LONG_MAX
+#include <errno.h>
+#if defined(__APPLE__)
+#include <sys/mount.h> // fstatfs()
+#else
+#include <sys/statvfs.h> // fstatvfs()
+#endif
 
 int _my_dir_mkdir(const char* path) {
     return mkdir(path, 0755);
@@ -54,6 +68,137 @@ int my_file_set_lastWriteTime(const char* path, bool isDir, time_t mtime) {
     return utime(path, &t);
 }
 
+int my_file_rename(const char* oldPath, const char* newPath) {
+    return rename(oldPath, newPath); // replace [newPath] if already exists
+}
+
+int my_file_remove(const char* path) {
+    return remove(path);
+}
+
+MyFileHandle my_file_open_read(const char* path) {
+    return open(path, O_RDONLY);
+}
+
+MyFileHandle my_file_open_read_shared(const char* path) {
+    return open(path, O_RDONLY); // pread() of many threads run in parallel
+}
+
+int my_file_pread(MyFileHandle fd, void* buf, size_t len, uint64_t offset) {
+    char* p = (char*) buf;
+    while (len > 0) {
+#if defined(__APPLE__) || defined(__LP64__)
+        ssize_t readLen = pread(fd, p, len, (off_t) offset); // off_t is 64-bit
+#else
+        ssize_t readLen = pread64(fd, p, len, (off64_t) offset);
+#endif
+        if (readLen < 0 && errno == EINTR) continue;
+        if (readLen <= 0) return -1; // error, or file is smaller than expected
+        p += readLen;
+        len -= (size_t) readLen;
+        offset += (uint64_t) readLen;
+    }
+    return 0;
+}
+
+MyFileHandle my_file_open_write(const char* path) {
+    return open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+int my_file_pwrite(MyFileHandle fd, const void* buf, size_t len, uint64_t offset) {
+    const char* p = (const char*) buf;
+    while (len > 0) {
+#if defined(__APPLE__) || defined(__LP64__)
+        ssize_t writtenLen = pwrite(fd, p, len, (off_t) offset);
+#else
+        ssize_t writtenLen = pwrite64(fd, p, len, (off64_t) offset);
+#endif
+        if (writtenLen < 0 && errno == EINTR) continue;
+        if (writtenLen <= 0) return -1;
+        p += writtenLen;
+        len -= (size_t) writtenLen;
+        offset += (uint64_t) writtenLen;
+    }
+    return 0;
+}
+
+void my_file_close(MyFileHandle fd) {
+    if (fd >= 0) close(fd);
+}
+
+int my_file_fseek64(FILE* fp, int64_t offset, int origin) {
+#if defined(__APPLE__) || defined(__LP64__)
+    return fseeko(fp, (off_t) offset, origin); // off_t is 64-bit
+#elif defined(__ANDROID__) && __ANDROID_API__ < 24
+    if (offset > LONG_MAX || offset < -LONG_MAX) return -1; // fseeko64() is not available
+    return fseek(fp, (long) offset, origin);
+#else
+    return fseeko64(fp, (off64_t) offset, origin);
+#endif
+}
+
+MyFileHandle my_file_get_handle(FILE* fp) {
+    return fileno(fp);
+}
+
+// free disk space of the file system [fd] is on, UINT64_MAX if unknown
+static uint64_t _my_file_free_space(MyFileHandle fd) {
+#if defined(__APPLE__)
+    struct statfs st;
+    if (fstatfs(fd, &st) == 0) return (uint64_t) st.f_bavail * st.f_bsize;
+#elif defined(__LP64__)
+    struct statvfs st;
+    if (fstatvfs(fd, &st) == 0) return (uint64_t) st.f_bavail * st.f_frsize;
+#elif !defined(__ANDROID__) || __ANDROID_API__ >= 21
+    struct statvfs64 st;
+    if (fstatvfs64(fd, &st) == 0) return (uint64_t) st.f_bavail * st.f_frsize;
+#endif
+    return UINT64_MAX;
+}
+
+void my_file_preallocate(MyFileHandle fd, uint64_t size) {
+    if (size == 0) return;
+    if (size > _my_file_free_space(fd)) return; // writing fails anyway, or [size] is wrong, don't take the rest of disk
+#if defined(__ANDROID__) && __ANDROID_API__ < 21
+    (void) fd; // fallocate() is not available
+#elif defined(__linux__) && defined(__LP64__)
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t) size); // NOTE: not posix_fallocate(), which writes zeros if not supported by file system
+#elif defined(__linux__)
+    fallocate64(fd, FALLOC_FL_KEEP_SIZE, 0, (off64_t) size);
+#elif defined(__APPLE__)
+    fstore_t store = { F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, (off_t) size, 0 };
+    if (fcntl(fd, F_PREALLOCATE, &store) == -1) {
+        store.fst_flags = F_ALLOCATEALL; // not enough contiguous space
+        fcntl(fd, F_PREALLOCATE, &store);
+    }
+#endif
+}
+
+int my_file_truncate(MyFileHandle fd, uint64_t size) {
+#if defined(__APPLE__) || defined(__LP64__)
+    return ftruncate(fd, (off_t) size); // NOTE: also releases blocks reserved by fallocate(FALLOC_FL_KEEP_SIZE)
+#else
+    return ftruncate64(fd, (off64_t) size);
+#endif
+}
+
+void my_file_drop_cache(MyFileHandle fd, uint64_t offset, uint64_t len) {
+#if defined(__linux__)
+#if !defined(__ANDROID__) || __ANDROID_API__ >= 26
+    sync_file_range(fd, (off64_t) offset, (off64_t) len, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#else
+    fdatasync(fd);
+#endif
+#if defined(__LP64__)
+    posix_fadvise(fd, (off_t) offset, (off_t) len, POSIX_FADV_DONTNEED); // NOTE: only clean pages are dropped
+#else
+    posix_fadvise64(fd, (off64_t) offset, (off64_t) len, POSIX_FADV_DONTNEED);
+#endif
+#elif defined(__APPLE__)
+    fcntl(fd, F_NOCACHE, 1); // the rest of file is written without cache
+#endif
+}
+
 // --------------------------------------------------------------------------
 
 int _my_dir_findNext(MyDir* pDir) {
@@ -90,4 +235,268 @@ int _my_dir_close(MyDir* pDir) {
     return 0;
 }
 
+// --------------------------------------------------------------------------
+// io_uring, by raw syscalls without liburing
+// NOTE: android blocks io_uring syscalls for apps by seccomp, so it is not used in android
+// --------------------------------------------------------------------------
+
+#if defined(NATIVE_ZIP_IO_URING) && defined(__linux__) && !defined(__ANDROID__)
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h> // struct iovec
+#include <stdlib.h>
+#include <errno.h>
+
+#define MY_FILE_RING_MAX_IO_SIZE (1024 * 1024 * 1024) // max bytes of each read / write
+
+struct MyFileRing {
+    int fd;
+    unsigned int entries;
+    bool isBroken; // io_uring_enter() failed, and some requests may be still in the ring
+    unsigned int pending; // in the submission queue, but not consumed by kernel yet
+    unsigned int inflight; // consumed by kernel, but not completed yet
+    int err; // any request failed since last my_file_ring_wait()
+    char* fixedBuf; // registered by my_file_ring_register_buffer(), NULL if not
+    size_t fixedLen;
+
+    void* sqPtr; // submission queue
+    size_t sqSize;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    struct io_uring_sqe* sqes;
+    size_t sqesSize;
+
+    void* cqPtr; // completion queue
+    size_t cqSize;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    struct io_uring_cqe* cqes;
+};
+
+void my_file_ring_destroy(MyFileRing* ring) {
+    if (!ring) return;
+    if (ring->sqes) munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqPtr && ring->cqPtr != ring->sqPtr) munmap(ring->cqPtr, ring->cqSize);
+    if (ring->sqPtr) munmap(ring->sqPtr, ring->sqSize);
+    close(ring->fd);
+    free(ring);
+}
+
+static void* _my_file_ring_mmap(int fd, size_t size, off_t offset) {
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+MyFileRing* my_file_ring_create(unsigned int queueDepth) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int) syscall(__NR_io_uring_setup, queueDepth, &p);
+    if (fd < 0) return NULL; // not supported by kernel, or disabled
+
+    MyFileRing* ring = (MyFileRing*) calloc(1, sizeof(MyFileRing));
+    if (ring == NULL) {
+        close(fd);
+        return NULL;
+    }
+    ring->fd = fd;
+    ring->entries = p.sq_entries;
+    ring->sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool isSingleMmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (isSingleMmap) {
+        if (ring->cqSize > ring->sqSize) ring->sqSize = ring->cqSize;
+        ring->cqSize = ring->sqSize;
+    }
+    ring->sqPtr = _my_file_ring_mmap(fd, ring->sqSize, IORING_OFF_SQ_RING);
+    ring->cqPtr = isSingleMmap ? ring->sqPtr : _my_file_ring_mmap(fd, ring->cqSize, IORING_OFF_CQ_RING);
+    ring->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*) _my_file_ring_mmap(fd, ring->sqesSize, IORING_OFF_SQES);
+    if (!ring->sqPtr || !ring->cqPtr || !ring->sqes) {
+        my_file_ring_destroy(ring);
+        return NULL;
+    }
+
+    char* sq = (char*) ring->sqPtr;
+    ring->sqTail = (unsigned*) (sq + p.sq_off.tail);
+    ring->sqMask = (unsigned*) (sq + p.sq_off.ring_mask);
+    ring->sqArray = (unsigned*) (sq + p.sq_off.array);
+    char* cq = (char*) ring->cqPtr;
+    ring->cqHead = (unsigned*) (cq + p.cq_off.head);
+    ring->cqTail = (unsigned*) (cq + p.cq_off.tail);
+    ring->cqMask = (unsigned*) (cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+    return ring;
+}
+
+// finish the rest of a short read / write by blocking call
+static int _my_file_ring_finish_sync(MyFileIoRequest* req) {
+    while (req->len > 0) {
+        ssize_t n = req->isWrite ? pwrite(req->fd, req->buf, req->len, req->offset) : pread(req->fd, req->buf, req->len, req->offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1; // error, or unexpected end of file
+        req->buf += n;
+        req->len -= n;
+        req->offset += n;
+    }
+    return 0;
+}
+
+// submit requests in the submission queue, and handle all completions already done,
+// if [waitCount] > 0, wait until at least [waitCount] requests completed
+static int _my_file_ring_enter(MyFileRing* ring, unsigned int waitCount) {
+    while (1) {
+        int ret = (int) syscall(__NR_io_uring_enter, ring->fd, ring->pending, waitCount, waitCount ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (ret < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY)) continue;
+        if (ret < 0) {
+            ring->isBroken = true; // NOTE: never happen normally, requests in the ring may be still running
+            return -1;
+        }
+        ring->pending -= ret;
+        ring->inflight += ret;
+        break;
+    }
+
+    unsigned int head = *ring->cqHead;
+    while (head != __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cqMask];
+        MyFileIoRequest* req = (MyFileIoRequest*) (uintptr_t) cqe->user_data;
+        if (cqe->res <= 0) {
+            ring->err = -1; // error, or unexpected end of file
+            req->isFailed = true;
+        }
+        else {
+            req->buf += cqe->res;
+            req->len -= cqe->res;
+            req->offset += cqe->res;
+            if (req->len > 0 && _my_file_ring_finish_sync(req) != 0) {
+                ring->err = -1;
+                req->isFailed = true;
+            }
+        }
+        head++;
+        ring->inflight--;
+    }
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int my_file_ring_submit(MyFileRing* ring, MyFileIoRequest* reqs, int count) {
+    // NOTE: 'reqs' are modified
+    if (ring->isBroken) return -1;
+
+    for (int i = 0; i < count; i++) {
+        MyFileIoRequest* req = &reqs[i];
+        if (req->len == 0) continue;
+        while (ring->pending + ring->inflight >= ring->entries) { // queue is full, wait for any request done
+            if (_my_file_ring_enter(ring, 1) != 0) return -1;
+        }
+
+        unsigned int tail = *ring->sqTail; // NOTE: only modified by us
+        unsigned int index = tail & *ring->sqMask;
+        struct io_uring_sqe* sqe = &ring->sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->fd = req->fd;
+        sqe->addr = (uint64_t) (uintptr_t) req->buf;
+        sqe->len = (unsigned) (req->len < MY_FILE_RING_MAX_IO_SIZE ? req->len : MY_FILE_RING_MAX_IO_SIZE);
+        bool isFixed = ring->fixedBuf && req->buf >= ring->fixedBuf && req->buf + sqe->len <= ring->fixedBuf + ring->fixedLen;
+        if (isFixed) sqe->opcode = req->isWrite ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED; // sqe->buf_index = 0
+        else sqe->opcode = req->isWrite ? IORING_OP_WRITE : IORING_OP_READ;
+        req->isFailed = false;
+        sqe->off = (uint64_t) req->offset;
+        sqe->user_data = (uint64_t) (uintptr_t) req;
+        ring->sqArray[index] = index;
+        __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+        ring->pending++;
+    }
+    return ring->pending > 0 ? _my_file_ring_enter(ring, 0) : 0;
+}
+
+int my_file_ring_wait(MyFileRing* ring) {
+    while (!ring->isBroken && (ring->pending > 0 || ring->inflight > 0)) {
+        if (_my_file_ring_enter(ring, 1) != 0) break;
+    }
+    int err = ring->isBroken ? -1 : ring->err;
+    ring->err = 0;
+    return err;
+}
+
+int my_file_ring_wait_request(MyFileRing* ring, MyFileIoRequest* req) {
+    while (!ring->isBroken && req->len > 0 && !req->isFailed) {
+        if (_my_file_ring_enter(ring, 1) != 0) break;
+    }
+    return ring->isBroken || req->isFailed ? -1 : 0;
+}
+
+int my_file_ring_register_buffer(MyFileRing* ring, void* buf, size_t len) {
+    // NOTE: pages are pinned, fails if exceeds RLIMIT_MEMLOCK, then requests just use IORING_OP_READ / WRITE
+    struct iovec iov = { buf, len };
+    if (ring->fixedBuf || syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, &iov, 1) != 0) return -1;
+    ring->fixedBuf = (char*) buf;
+    ring->fixedLen = len;
+    return 0;
+}
+
+int my_file_ring_read_files(MyFileRing* ring, const char** paths, char** bufs, const size_t* lens, int count) {
+    MyFileIoRequest* reqs = (MyFileIoRequest*) calloc(count, sizeof(MyFileIoRequest));
+    if (reqs == NULL) return -1;
+
+    int err = 0;
+    int opened = 0;
+    for (; opened < count; opened++) {
+        int fd = open(paths[opened], O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            err = -1;
+            break;
+        }
+        MyFileIoRequest req = { fd, false, bufs[opened], lens[opened], 0 };
+        reqs[opened] = req;
+    }
+    if (err == 0 && my_file_ring_submit(ring, reqs, count) != 0) err = -1;
+    if (my_file_ring_wait(ring) != 0) err = -1; // NOTE: always wait, some requests may be submitted
+    for (int i = 0; i < opened; i++) close(reqs[i].fd);
+    free(reqs);
+    return err;
+}
+
+#else
+
+MyFileRing* my_file_ring_create(unsigned int queueDepth) {
+    (void) queueDepth;
+    return NULL; // not supported, use stdio instead
+}
+
+int my_file_ring_submit(MyFileRing* ring, MyFileIoRequest* reqs, int count) {
+    (void) ring; (void) reqs; (void) count;
+    return -1;
+}
+
+int my_file_ring_wait(MyFileRing* ring) {
+    (void) ring;
+    return -1;
+}
+
+int my_file_ring_wait_request(MyFileRing* ring, MyFileIoRequest* req) {
+    (void) ring; (void) req;
+    return -1;
+}
+
+int my_file_ring_register_buffer(MyFileRing* ring, void* buf, size_t len) {
+    (void) ring; (void) buf; (void) len;
+    return -1;
+}
+
+int my_file_ring_read_files(MyFileRing* ring, const char** paths, char** bufs, const size_t* lens, int count) {
+    (void) ring; (void) paths; (void) bufs; (void) lens; (void) count;
+    return -1;
+}
+
+void my_file_ring_destroy(MyFileRing* ring) {
+    (void) ring;
+}
+
+#endif
+
 #endif
\ No newline at end of file
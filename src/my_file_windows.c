@@ -42,10 +42,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <io.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 // *** NOTE: in windows,
 //     mkdir(), stat(), fopen() doesn't work with non-english utf8 path,
-//     so we use _wmkdir(), _wstat(), _wfopen_s() instead
+//     so we use _wmkdir(), _wstat64(), _wfopen_s() instead
 
 thd_mutex __mutex_mkdir;
 int __mutex_mkdir_inited = 0;
@@ -67,7 +68,7 @@ int _my_dir_mkdir(const char* path) {
 int my_file_stat(const char* path, NATIVE_FILE_STAT *st) {
     WCHAR buf[MAX_PATH_CHAR_COUNT];
     MultiByteToWideChar(CP_UTF8, 0, path, -1, buf, sizeof(buf) / sizeof(WCHAR));
-    return _wstat(buf, st);
+    return _wstat64(buf, st);
 }
 
 void _my_file_unix_time_to_FILETIME(time_t t, FILETIME* ft) {
@@ -100,6 +101,154 @@ int _my_file_fopen_windows(FILE** fp, const char* path, WCHAR* mode) {
     return _wfopen_s(fp, buf, mode);
 }
 
+int my_file_rename(const char* oldPath, const char* newPath) {
+    // replace [newPath] if already exists
+    WCHAR* buf = (WCHAR*)malloc(sizeof(WCHAR) * MAX_PATH_CHAR_COUNT * 2);
+    WCHAR* buf2 = buf + MAX_PATH_CHAR_COUNT;
+    MultiByteToWideChar(CP_UTF8, 0, oldPath, -1, buf, MAX_PATH_CHAR_COUNT);
+    MultiByteToWideChar(CP_UTF8, 0, newPath, -1, buf2, MAX_PATH_CHAR_COUNT);
+    bool ret = MoveFileExW(buf, buf2, MOVEFILE_REPLACE_EXISTING);
+    free(buf);
+    return ret ? 0 : -1;
+}
+
+int my_file_remove(const char* path) {
+    WCHAR buf[MAX_PATH_CHAR_COUNT];
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, buf, sizeof(buf) / sizeof(WCHAR));
+    return _wremove(buf);
+}
+
+MyFileHandle my_file_open_read(const char* path) {
+    WCHAR buf[MAX_PATH_CHAR_COUNT];
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, buf, sizeof(buf) / sizeof(WCHAR));
+    return CreateFileW(buf, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+}
+
+MyFileHandle my_file_open_read_shared(const char* path) {
+    // NOTE: I/O on a synchronous handle is serialized by windows, even with OVERLAPPED offset,
+    //       so the handle is opened for overlapped I/O, then reads of many threads run in parallel
+    WCHAR buf[MAX_PATH_CHAR_COUNT];
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, buf, sizeof(buf) / sizeof(WCHAR));
+    return CreateFileW(buf, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED | FILE_FLAG_RANDOM_ACCESS, NULL);
+}
+
+int my_file_pread(MyFileHandle fd, void* buf, size_t len, uint64_t offset) {
+    // NOTE: each read waits its own event, the handle may be opened by my_file_open_read_shared() and read by other threads now
+    HANDLE hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (hEvent == NULL) return -1;
+    char* p = (char*) buf;
+    int err = 0;
+    while (len > 0) {
+        // NOTE: ReadFile() with OVERLAPPED offset on a synchronous handle reads at that offset
+        DWORD count = len > (1u << 30) ? (1u << 30) : (DWORD) len;
+        DWORD readLen = 0;
+        OVERLAPPED ov = { 0 };
+        ov.Offset = (DWORD) offset;
+        ov.OffsetHigh = (DWORD) (offset >> 32);
+        ov.hEvent = hEvent;
+        BOOL isOk = ReadFile(fd, p, count, &readLen, &ov);
+        if (!isOk && GetLastError() == ERROR_IO_PENDING) isOk = GetOverlappedResult(fd, &ov, &readLen, TRUE);
+        if (!isOk || readLen == 0) { // error, or file is smaller than expected
+            err = -1;
+            break;
+        }
+        p += readLen;
+        len -= readLen;
+        offset += readLen;
+    }
+    CloseHandle(hEvent);
+    return err;
+}
+
+MyFileHandle my_file_open_write(const char* path) {
+    WCHAR buf[MAX_PATH_CHAR_COUNT];
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, buf, sizeof(buf) / sizeof(WCHAR));
+    return CreateFileW(buf, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+}
+
+int my_file_pwrite(MyFileHandle fd, const void* buf, size_t len, uint64_t offset) {
+    const char* p = (const char*) buf;
+    while (len > 0) {
+        DWORD count = len > (1u << 30) ? (1u << 30) : (DWORD) len;
+        DWORD writtenLen = 0;
+        OVERLAPPED ov = { 0 };
+        ov.Offset = (DWORD) offset;
+        ov.OffsetHigh = (DWORD) (offset >> 32);
+        if (!WriteFile(fd, p, count, &writtenLen, &ov) || writtenLen == 0) return -1;
+        p += writtenLen;
+        len -= writtenLen;
+        offset += writtenLen;
+    }
+    return 0;
+}
+
+void my_file_close(MyFileHandle fd) {
+    if (fd != MY_FILE_INVALID_HANDLE) CloseHandle(fd);
+}
+
+int my_file_fseek64(FILE* fp, int64_t offset, int origin) {
+    return _fseeki64(fp, offset, origin);
+}
+
+MyFileHandle my_file_get_handle(FILE* fp) {
+    return (HANDLE) _get_osfhandle(_fileno(fp));
+}
+
+void my_file_preallocate(MyFileHandle fd, uint64_t size) {
+    FILE_ALLOCATION_INFO info;
+    info.AllocationSize.QuadPart = (LONGLONG) size; // file size is not changed
+    SetFileInformationByHandle(fd, FileAllocationInfo, &info, sizeof(info)); // NOTE: fails without reserving anything if disk is full
+}
+
+int my_file_truncate(MyFileHandle fd, uint64_t size) {
+    FILE_END_OF_FILE_INFO eof;
+    eof.EndOfFile.QuadPart = (LONGLONG) size;
+    if (!SetFileInformationByHandle(fd, FileEndOfFileInfo, &eof, sizeof(eof))) return -1;
+    FILE_ALLOCATION_INFO info;
+    info.AllocationSize.QuadPart = (LONGLONG) size; // release space reserved by my_file_preallocate()
+    return SetFileInformationByHandle(fd, FileAllocationInfo, &info, sizeof(info)) ? 0 : -1;
+}
+
+void my_file_drop_cache(MyFileHandle fd, uint64_t offset, uint64_t len) {
+    // NOTE: not supported, FILE_FLAG_NO_BUFFERING requires sector aligned writes
+    (void) fd; (void) offset; (void) len;
+}
+
+// io_uring is linux only, callers use stdio instead
+MyFileRing* my_file_ring_create(unsigned int queueDepth) {
+    (void) queueDepth;
+    return NULL;
+}
+
+int my_file_ring_submit(MyFileRing* ring, MyFileIoRequest* reqs, int count) {
+    (void) ring; (void) reqs; (void) count;
+    return -1;
+}
+
+int my_file_ring_wait(MyFileRing* ring) {
+    (void) ring;
+    return -1;
+}
+
+int my_file_ring_wait_request(MyFileRing* ring, MyFileIoRequest* req) {
+    (void) ring; (void) req;
+    return -1;
+}
+
+int my_file_ring_register_buffer(MyFileRing* ring, void* buf, size_t len) {
+    (void) ring; (void) buf; (void) len;
+    return -1;
+}
+
+int my_file_ring_read_files(MyFileRing* ring, const char** paths, char** bufs, const size_t* lens, int count) {
+    (void) ring; (void) paths; (void) bufs; (void) lens; (void) count;
+    return -1;
+}
+
+void my_file_ring_destroy(MyFileRing* ring) {
+    (void) ring;
+}
+
 char* _my_dir_current_file_name(MyDir* pDir) {
     if (pDir->_utf8Filename[0] == 0) {
         WideCharToMultiByte(CP_UTF8, 0, pDir->info.cFileName, -1, pDir->_utf8Filename, sizeof(pDir->_utf8Filename), NULL, NULL);
@@ -113,7 +262,7 @@ void _my_dir_findNext_copyStat(MyDir* pDir) {
     pDir->st.st_mode = _S_IFDIR;   
     if ((pDir->info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
         pDir->st.st_mode = _S_IFREG;
-        pDir->st.st_size = ((size_t)pDir->info.nFileSizeHigh << 32) | pDir->info.nFileSizeLow;
+        pDir->st.st_size = ((uint64_t)pDir->info.nFileSizeHigh << 32) | pDir->info.nFileSizeLow;
     }
 
     if (pDir->info.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
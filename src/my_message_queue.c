@@ -63,6 +63,29 @@ int mq_push(MessageQueue* mq, void* data) {
     return ret;
 }
 
+// push [data] before all messages, so it is popped next
+int mq_push_front(MessageQueue* mq, void* data) {
+    int ret = 0;
+    Message* msg = (Message*)malloc(sizeof(Message));
+    if (!msg) return -1;
+    msg->data = data;
+
+    thd_mutex_lock(&mq->lock);
+    if (mq->closed) {
+        ret = -1;
+        free(msg);
+    }
+    else {
+        msg->next = mq->head;
+        mq->head = msg;
+        if (!mq->tail) mq->tail = msg;
+        thd_condition_signal(&mq->not_empty);
+    }
+    thd_mutex_unlock(&mq->lock);
+
+    return ret;
+}
+
 void* mq_pop_timeout(MessageQueue* mq, size_t timeoutMs) {
     // [timeoutMs] < 0 means no timeout
     void *ret = NULL;
@@ -94,4 +117,22 @@ void* mq_pop_timeout(MessageQueue* mq, size_t timeoutMs) {
 
 void* mq_pop(MessageQueue* mq) {
     return mq_pop_timeout(mq, -1);
-}
\ No newline at end of file
+}
+
+// pop without waiting, return false if queue is empty
+// NOTE: NULL may be pushed as a message, so the message is returned by [data]
+bool mq_try_pop(MessageQueue* mq, void** data) {
+    bool ret = false;
+    thd_mutex_lock(&mq->lock);
+    if (mq->head) {
+        Message* msg = mq->head;
+        mq->head = msg->next;
+        if (!mq->head)
+            mq->tail = NULL;
+        *data = msg->data;
+        free(msg);
+        ret = true;
+    }
+    thd_mutex_unlock(&mq->lock);
+    return ret;
+}
@@ -26,5 +26,7 @@ void mq_init(MessageQueue* mq);
 void mq_close(MessageQueue* mq);
 void mq_destroy(MessageQueue* mq, _mq_free_func free_func);
 int mq_push(MessageQueue* mq, void* data);
+int mq_push_front(MessageQueue* mq, void* data);
 void* mq_pop(MessageQueue* mq);
 void* mq_pop_timeout(MessageQueue* mq, size_t timeoutMs);
+bool mq_try_pop(MessageQueue* mq, void** data);
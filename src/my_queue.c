@@ -59,4 +59,22 @@ void* queue_pop(Queue* q) {
 void* queue_peek(Queue* q) {
     if (queue_is_empty(q)) return NULL;
     return q->front->data;
-}
\ No newline at end of file
+}
+
+bool queue_remove(Queue* q, void* data) {
+    // remove the first node holding [data], return false if not found
+    _queue_node* prev = NULL;
+    _queue_node* node = q->front;
+    while (node && node->data != data) {
+        prev = node;
+        node = node->next;
+    }
+    if (node == NULL) return false;
+
+    if (prev) prev->next = node->next;
+    else q->front = node->next;
+    if (q->rear == node) q->rear = prev;
+    free(node);
+    q->size--;
+    return true;
+}
@@ -21,3 +21,4 @@ int queue_size(Queue* q);
 bool queue_push(Queue* q, void* data);
 void* queue_pop(Queue* q);
 void* queue_peek(Queue* q);
+bool queue_remove(Queue* q, void* data);
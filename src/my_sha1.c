@@ -0,0 +1,284 @@
+#include "my_sha1.h"
+
+#include <string.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MY_SHA1_X86
+#endif
+
+typedef void (*_my_sha1_blocks_func)(uint32_t state[5], const uint8_t* data, size_t blockCount);
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+// message schedule is computed on the fly in a 16-word ring, and all 80 steps are unrolled
+#define SHA1_W(i) (w[(i) & 15] = ROTL32(w[((i) + 13) & 15] ^ w[((i) + 8) & 15] ^ w[((i) + 2) & 15] ^ w[(i) & 15], 1))
+#define SHA1_R(a, b, c, d, e, f, k, x) do { \
+        e += ROTL32(a, 5) + (f) + (k) + (x); \
+        b = ROTL32(b, 30); \
+    } while (0)
+#define SHA1_F1(b, c, d) ((d) ^ ((b) & ((c) ^ (d))))
+#define SHA1_F2(b, c, d) ((b) ^ (c) ^ (d))
+#define SHA1_F3(b, c, d) (((b) & (c)) | ((d) & ((b) | (c))))
+#define SHA1_R0(a, b, c, d, e, i) SHA1_R(a, b, c, d, e, SHA1_F1(b, c, d), 0x5A827999, w[i])
+#define SHA1_R1(a, b, c, d, e, i) SHA1_R(a, b, c, d, e, SHA1_F1(b, c, d), 0x5A827999, SHA1_W(i))
+#define SHA1_R2(a, b, c, d, e, i) SHA1_R(a, b, c, d, e, SHA1_F2(b, c, d), 0x6ED9EBA1, SHA1_W(i))
+#define SHA1_R3(a, b, c, d, e, i) SHA1_R(a, b, c, d, e, SHA1_F3(b, c, d), 0x8F1BBCDC, SHA1_W(i))
+#define SHA1_R4(a, b, c, d, e, i) SHA1_R(a, b, c, d, e, SHA1_F2(b, c, d), 0xCA62C1D6, SHA1_W(i))
+#define SHA1_5(R, i) \
+    R(a, b, c, d, e, i); R(e, a, b, c, d, i + 1); R(d, e, a, b, c, i + 2); R(c, d, e, a, b, i + 3); R(b, c, d, e, a, i + 4)
+
+static void _my_sha1_transform(uint32_t state[5], const uint8_t block[64]) {
+    uint32_t w[16];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) | ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    SHA1_5(SHA1_R0, 0); SHA1_5(SHA1_R0, 5); SHA1_5(SHA1_R0, 10);
+    SHA1_R0(a, b, c, d, e, 15); SHA1_R1(e, a, b, c, d, 16); SHA1_R1(d, e, a, b, c, 17); SHA1_R1(c, d, e, a, b, 18); SHA1_R1(b, c, d, e, a, 19);
+    SHA1_5(SHA1_R2, 20); SHA1_5(SHA1_R2, 25); SHA1_5(SHA1_R2, 30); SHA1_5(SHA1_R2, 35);
+    SHA1_5(SHA1_R3, 40); SHA1_5(SHA1_R3, 45); SHA1_5(SHA1_R3, 50); SHA1_5(SHA1_R3, 55);
+    SHA1_5(SHA1_R4, 60); SHA1_5(SHA1_R4, 65); SHA1_5(SHA1_R4, 70); SHA1_5(SHA1_R4, 75);
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+static void _my_sha1_blocks_scalar(uint32_t state[5], const uint8_t* data, size_t blockCount) {
+    for (; blockCount > 0; blockCount--, data += 64) _my_sha1_transform(state, data);
+}
+
+// --------------------------------------------------------------------------
+// x86: SHA extensions (same as the sample code of Intel)
+// --------------------------------------------------------------------------
+
+#ifdef MY_SHA1_X86
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MY_TARGET_SHA
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define MY_TARGET_SHA __attribute__((target("sha,sse4.1")))
+#endif
+
+static bool _my_sha1_x86_supported() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 19))) return false; // SSE4.1
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 29)) != 0; // SHA
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & (1u << 19))) return false; // SSE4.1
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+    return (ebx & (1u << 29)) != 0; // SHA
+#endif
+}
+
+// 4 rounds of group [g], [m0] is the message of this group, [m1] [m2] [m3] are messages of next groups
+#define SHA1NI_ROUNDS(g, e0, e1, m0, m1, m2, m3) do { \
+        e0 = _mm_sha1nexte_epu32(e0, m0); \
+        e1 = abcd; \
+        if ((g) >= 3 && (g) <= 18) m1 = _mm_sha1msg2_epu32(m1, m0); \
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, (g) / 5); \
+        if ((g) >= 1 && (g) <= 16) m3 = _mm_sha1msg1_epu32(m3, m0); \
+        if ((g) >= 2 && (g) <= 17) m2 = _mm_xor_si128(m2, m0); \
+    } while (0)
+
+MY_TARGET_SHA
+static void _my_sha1_blocks_shani(uint32_t state[5], const uint8_t* data, size_t blockCount) {
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*) state), 0x1B);
+    __m128i e0 = _mm_set_epi32((int) state[4], 0, 0, 0);
+    __m128i e1, msg0, msg1, msg2, msg3;
+
+    for (; blockCount > 0; blockCount--, data += 64) {
+        __m128i abcdSaved = abcd;
+        __m128i e0Saved = e0;
+        msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) data), mask);
+        msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + 16)), mask);
+        msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + 32)), mask);
+        msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + 48)), mask);
+
+        // rounds 0-3, 'e' is not rotated from previous rounds yet
+        e0 = _mm_add_epi32(e0, msg0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        SHA1NI_ROUNDS(1, e1, e0, msg1, msg2, msg3, msg0);
+        SHA1NI_ROUNDS(2, e0, e1, msg2, msg3, msg0, msg1);
+        SHA1NI_ROUNDS(3, e1, e0, msg3, msg0, msg1, msg2);
+        SHA1NI_ROUNDS(4, e0, e1, msg0, msg1, msg2, msg3);
+        SHA1NI_ROUNDS(5, e1, e0, msg1, msg2, msg3, msg0);
+        SHA1NI_ROUNDS(6, e0, e1, msg2, msg3, msg0, msg1);
+        SHA1NI_ROUNDS(7, e1, e0, msg3, msg0, msg1, msg2);
+        SHA1NI_ROUNDS(8, e0, e1, msg0, msg1, msg2, msg3);
+        SHA1NI_ROUNDS(9, e1, e0, msg1, msg2, msg3, msg0);
+        SHA1NI_ROUNDS(10, e0, e1, msg2, msg3, msg0, msg1);
+        SHA1NI_ROUNDS(11, e1, e0, msg3, msg0, msg1, msg2);
+        SHA1NI_ROUNDS(12, e0, e1, msg0, msg1, msg2, msg3);
+        SHA1NI_ROUNDS(13, e1, e0, msg1, msg2, msg3, msg0);
+        SHA1NI_ROUNDS(14, e0, e1, msg2, msg3, msg0, msg1);
+        SHA1NI_ROUNDS(15, e1, e0, msg3, msg0, msg1, msg2);
+        SHA1NI_ROUNDS(16, e0, e1, msg0, msg1, msg2, msg3);
+        SHA1NI_ROUNDS(17, e1, e0, msg1, msg2, msg3, msg0);
+        SHA1NI_ROUNDS(18, e0, e1, msg2, msg3, msg0, msg1);
+        SHA1NI_ROUNDS(19, e1, e0, msg3, msg0, msg1, msg2);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0Saved);
+        abcd = _mm_add_epi32(abcd, abcdSaved);
+    }
+
+    _mm_storeu_si128((__m128i*) state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = (uint32_t) _mm_extract_epi32(e0, 3);
+}
+
+#endif // MY_SHA1_X86
+
+// --------------------------------------------------------------------------
+
+static _my_sha1_blocks_func _my_sha1_select() {
+#if defined(MY_SHA1_X86)
+    if (_my_sha1_x86_supported()) return _my_sha1_blocks_shani;
+#endif
+    return _my_sha1_blocks_scalar;
+}
+
+static _my_sha1_blocks_func volatile _my_sha1_impl = NULL;
+
+static void _my_sha1_blocks(uint32_t state[5], const uint8_t* data, size_t blockCount) {
+    // NOTE: may be selected by multiple threads at the same time, but they always select the same function
+    _my_sha1_blocks_func func = _my_sha1_impl;
+    if (func == NULL) {
+        func = _my_sha1_select();
+        _my_sha1_impl = func;
+    }
+    func(state, data, blockCount);
+}
+
+void my_sha1_init(MySha1* ctx) {
+    ctx->state[0] = 0x67452301;
+    ctx->state[1] = 0xEFCDAB89;
+    ctx->state[2] = 0x98BADCFE;
+    ctx->state[3] = 0x10325476;
+    ctx->state[4] = 0xC3D2E1F0;
+    ctx->count = 0;
+}
+
+void my_sha1_update(MySha1* ctx, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    size_t used = (size_t)(ctx->count & 63);
+    ctx->count += len;
+
+    if (used > 0) {
+        size_t n = 64 - used;
+        if (len < n) {
+            memcpy(ctx->buf + used, p, len);
+            return;
+        }
+        memcpy(ctx->buf + used, p, n);
+        _my_sha1_blocks(ctx->state, ctx->buf, 1);
+        p += n;
+        len -= n;
+    }
+    if (len >= 64) {
+        size_t blockCount = len / 64;
+        _my_sha1_blocks(ctx->state, p, blockCount);
+        p += blockCount * 64;
+        len -= blockCount * 64;
+    }
+    if (len > 0) memcpy(ctx->buf, p, len);
+}
+
+void my_sha1_final(MySha1* ctx, uint8_t digest[MY_SHA1_DIGEST_SIZE]) {
+    uint64_t bits = ctx->count * 8;
+    size_t used = (size_t)(ctx->count & 63);
+    ctx->buf[used++] = 0x80;
+    if (used > 56) {
+        memset(ctx->buf + used, 0, 64 - used);
+        _my_sha1_blocks(ctx->state, ctx->buf, 1);
+        used = 0;
+    }
+    memset(ctx->buf + used, 0, 56 - used);
+    for (int i = 0; i < 8; i++) ctx->buf[56 + i] = (uint8_t)(bits >> (56 - i * 8));
+    _my_sha1_blocks(ctx->state, ctx->buf, 1);
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = (uint8_t)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)ctx->state[i];
+    }
+}
+
+// --------------------------------------------------------------------------
+
+void my_hmac_sha1_init(MyHmacSha1* ctx, const void* key, size_t keyLen) {
+    uint8_t pad[64];
+    uint8_t keyHash[MY_SHA1_DIGEST_SIZE];
+    if (keyLen > 64) { // long key is hashed first
+        my_sha1_init(&ctx->inner);
+        my_sha1_update(&ctx->inner, key, keyLen);
+        my_sha1_final(&ctx->inner, keyHash);
+        key = keyHash;
+        keyLen = MY_SHA1_DIGEST_SIZE;
+    }
+
+    memset(pad, 0x36, sizeof(pad));
+    for (size_t i = 0; i < keyLen; i++) pad[i] ^= ((const uint8_t*)key)[i];
+    my_sha1_init(&ctx->inner);
+    my_sha1_update(&ctx->inner, pad, sizeof(pad));
+
+    memset(pad, 0x5c, sizeof(pad));
+    for (size_t i = 0; i < keyLen; i++) pad[i] ^= ((const uint8_t*)key)[i];
+    my_sha1_init(&ctx->outer);
+    my_sha1_update(&ctx->outer, pad, sizeof(pad));
+}
+
+void my_hmac_sha1_update(MyHmacSha1* ctx, const void* data, size_t len) {
+    my_sha1_update(&ctx->inner, data, len);
+}
+
+void my_hmac_sha1_final(MyHmacSha1* ctx, uint8_t mac[MY_SHA1_DIGEST_SIZE]) {
+    uint8_t innerHash[MY_SHA1_DIGEST_SIZE];
+    my_sha1_final(&ctx->inner, innerHash);
+    my_sha1_update(&ctx->outer, innerHash, sizeof(innerHash));
+    my_sha1_final(&ctx->outer, mac);
+}
+
+void my_pbkdf2_sha1(const void* password, size_t passwordLen, const void* salt, size_t saltLen, int iterations, uint8_t* out, size_t outLen) {
+    // padded key is hashed only once, then each iteration costs 2 sha1 blocks
+    MyHmacSha1 keyed;
+    my_hmac_sha1_init(&keyed, password, passwordLen);
+
+    for (uint32_t blockIndex = 1; outLen > 0; blockIndex++) {
+        uint8_t u[MY_SHA1_DIGEST_SIZE];
+        uint8_t t[MY_SHA1_DIGEST_SIZE];
+        uint8_t indexBytes[4] = { (uint8_t)(blockIndex >> 24), (uint8_t)(blockIndex >> 16), (uint8_t)(blockIndex >> 8), (uint8_t)blockIndex };
+
+        MyHmacSha1 ctx = keyed;
+        my_hmac_sha1_update(&ctx, salt, saltLen);
+        my_hmac_sha1_update(&ctx, indexBytes, 4);
+        my_hmac_sha1_final(&ctx, u);
+        memcpy(t, u, sizeof(t));
+        for (int i = 1; i < iterations; i++) {
+            ctx = keyed;
+            my_hmac_sha1_update(&ctx, u, sizeof(u));
+            my_hmac_sha1_final(&ctx, u);
+            for (int j = 0; j < MY_SHA1_DIGEST_SIZE; j++) t[j] ^= u[j];
+        }
+
+        size_t n = outLen < sizeof(t) ? outLen : sizeof(t);
+        memcpy(out, t, n);
+        out += n;
+        outLen -= n;
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h> // size_t
+#include <stdint.h>
+
+#define MY_SHA1_DIGEST_SIZE 20
+
+typedef struct MySha1 {
+    uint32_t state[5];
+    uint64_t count; // total bytes
+    uint8_t buf[64];
+} MySha1;
+
+void my_sha1_init(MySha1* ctx);
+void my_sha1_update(MySha1* ctx, const void* data, size_t len);
+void my_sha1_final(MySha1* ctx, uint8_t digest[MY_SHA1_DIGEST_SIZE]);
+
+typedef struct MyHmacSha1 {
+    MySha1 inner;
+    MySha1 outer;
+} MyHmacSha1;
+
+void my_hmac_sha1_init(MyHmacSha1* ctx, const void* key, size_t keyLen);
+void my_hmac_sha1_update(MyHmacSha1* ctx, const void* data, size_t len);
+void my_hmac_sha1_final(MyHmacSha1* ctx, uint8_t mac[MY_SHA1_DIGEST_SIZE]);
+
+// PBKDF2 with HMAC-SHA1 (RFC 2898), used by WinZip AES to derive keys from password
+void my_pbkdf2_sha1(const void* password, size_t passwordLen, const void* salt, size_t saltLen, int iterations, uint8_t* out, size_t outLen);
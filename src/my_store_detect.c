@@ -0,0 +1,117 @@
+#include "my_store_detect.h"
+#include "native_zip.h"
+#include "my_file.h"
+
+#include <zlib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define min(a,b) (((a) < (b)) ? (a) : (b))
+
+#define STORE_DETECT_MIN_SAVING_PERCENT 3 // store the file if deflate saves less than this
+
+static const char* _compressed_extensions[] = {
+    "jpg", "jpeg", "png", "gif", "webp", "heic", "heif", "avif",
+    "mp3", "aac", "m4a", "ogg", "opus", "flac",
+    "mp4", "m4v", "mov", "mkv", "webm", "3gp",
+    "zip", "gz", "tgz", "bz2", "xz", "txz", "zst", "7z", "rar", "lz4", "br",
+    "apk", "aab", "ipa", "jar", "aar", "docx", "xlsx", "pptx", "epub", "woff2",
+    NULL
+};
+
+typedef struct {
+    size_t offset;
+    size_t len;
+    const char* magic;
+} _magic_info;
+
+static const _magic_info _compressed_magics[] = {
+    { 0, 3, "\xFF\xD8\xFF" },             // jpeg
+    { 0, 8, "\x89PNG\r\n\x1A\n" },        // png
+    { 0, 4, "GIF8" },                     // gif
+    { 0, 4, "PK\x03\x04" },               // zip, apk, jar, docx, ...
+    { 0, 2, "\x1F\x8B" },                 // gzip
+    { 0, 6, "7z\xBC\xAF\x27\x1C" },       // 7z
+    { 0, 4, "Rar!" },                     // rar
+    { 0, 6, "\xFD" "7zXZ\x00" },          // xz
+    { 0, 3, "BZh" },                      // bzip2
+    { 0, 4, "\x28\xB5\x2F\xFD" },         // zstd
+    { 0, 4, "\x04\x22\x4D\x18" },         // lz4
+    { 4, 4, "ftyp" },                     // mp4, mov, m4a, heic, avif, 3gp
+    { 8, 4, "WEBP" },                     // webp
+    { 0, 4, "OggS" },                     // ogg, opus
+    { 0, 4, "fLaC" },                     // flac
+    { 0, 3, "ID3" },                      // mp3
+    { 0, 4, "\x1A\x45\xDF\xA3" },         // mkv, webm
+    { 0, 0, NULL }
+};
+
+static bool _store_detect_by_extension(const char* filePath) {
+    const char* filename = _my_file_get_filename_from_path(filePath);
+    const char* ext = strrchr(filename, '.');
+    if (ext == NULL || ext[1] == '\0') return false;
+    ext++;
+
+    for (const char** p = _compressed_extensions; *p; p++) {
+        const char* s1 = ext;
+        const char* s2 = *p;
+        while (*s1 && tolower((unsigned char)*s1) == *s2) {
+            s1++;
+            s2++;
+        }
+        if (*s1 == '\0' && *s2 == '\0') return true;
+    }
+    return false;
+}
+
+static bool _store_detect_by_magic(const unsigned char* buf, size_t len) {
+    for (const _magic_info* m = _compressed_magics; m->magic; m++) {
+        if (m->offset + m->len > len) continue;
+        if (memcmp(buf + m->offset, m->magic, m->len) == 0) return true;
+    }
+    return false;
+}
+
+static bool _store_detect_by_sample(const unsigned char* buf, size_t len) {
+    // trial-compress the sample with the fastest level
+    uLongf outLen = compressBound((uLong)len);
+    Bytef* out = (Bytef*)malloc(outLen);
+    if (out == NULL) return false;
+    int err = compress2(out, &outLen, buf, (uLong)len, 1);
+    free(out);
+    if (err != Z_OK) return false;
+    return outLen * 100 >= len * (100 - STORE_DETECT_MIN_SAVING_PERCENT);
+}
+
+bool my_store_detect_by_extension(const char* filePath, int flags) {
+    return (flags & NZ_FLAG_STORE_BY_EXTENSION) && _store_detect_by_extension(filePath);
+}
+
+bool my_store_detect_by_data(const void* data, size_t len, int flags) {
+    const unsigned char* buf = (const unsigned char*)data;
+    if ((flags & NZ_FLAG_STORE_BY_MAGIC) && _store_detect_by_magic(buf, len)) return true;
+    if ((flags & NZ_FLAG_STORE_BY_SAMPLE) && len > 0) return _store_detect_by_sample(buf, min(len, MY_STORE_DETECT_SAMPLE_SIZE));
+    return false;
+}
+
+bool my_store_detect(const char* filePath, uint64_t fileSize, int flags) {
+    if (my_store_detect_by_extension(filePath, flags)) return true;
+    if (!(flags & (NZ_FLAG_STORE_BY_MAGIC | NZ_FLAG_STORE_BY_SAMPLE))) return false;
+    if (fileSize < MY_STORE_DETECT_MIN_FILE_SIZE) return false; // small file, not worth to read it here
+
+    FILE* fp = NULL;
+    _my_file_fopen(&fp, filePath, "rb");
+    if (fp == NULL) return false; // let compress thread report the error
+
+    size_t bufSize = (flags & NZ_FLAG_STORE_BY_SAMPLE) ? MY_STORE_DETECT_SAMPLE_SIZE : 16;
+    unsigned char* buf = (unsigned char*)malloc(bufSize);
+    size_t len = buf ? fread(buf, 1, bufSize, fp) : 0;
+    fclose(fp);
+
+    bool isStored = buf && my_store_detect_by_data(buf, len, flags);
+    free(buf);
+    return isStored;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h> // size_t
+#include <stdint.h> // uint64_t
+
+// --------------------------------------------------------------------------
+// detect files which are already compressed (e.g. .jpg, .mp4, .zip),
+// these files are stored into .zip without compression, deflate costs a lot of CPU but saves nothing
+// --------------------------------------------------------------------------
+
+#define MY_STORE_DETECT_MIN_FILE_SIZE (1024 * 64) // only check magic / sample for files larger than this
+#define MY_STORE_DETECT_SAMPLE_SIZE (1024 * 64)
+
+bool my_store_detect(const char* filePath, uint64_t fileSize, int flags); // [flags]: values in [NativeZipFlags]
+bool my_store_detect_by_extension(const char* filePath, int flags); // without any file I/O
+bool my_store_detect_by_data(const void* data, size_t len, int flags); // magic / sample check of the first [len] bytes of file
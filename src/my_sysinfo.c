@@ -0,0 +1,161 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // sched_getaffinity(), CPU_COUNT()
+#endif
+
+#include "my_sysinfo.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h> // sysconf()
+#include <time.h> // clock_gettime()
+#endif
+#ifdef __linux__
+#include <sched.h> // sched_getaffinity()
+#include <stdio.h>
+#include <string.h>
+#endif
+
+#include <stdint.h>
+
+#ifdef __linux__
+// "MemAvailable" of /proc/meminfo in bytes, or 0 if not exists (linux < 3.14)
+// NOTE: not _SC_AVPHYS_PAGES, which is "MemFree" without reclaimable page cache, and is small on any busy machine
+static uint64_t _my_sysinfo_meminfo_available(void) {
+    unsigned long long kb = 0;
+    FILE* fp = fopen("/proc/meminfo", "r");
+    if (fp == NULL) return 0;
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "MemAvailable: %llu kB", &kb) == 1) break;
+    }
+    fclose(fp);
+    return (uint64_t)kb * 1024;
+}
+#endif
+
+// return available physical memory in bytes, or 0 if unknown
+size_t my_sysinfo_get_available_memory(void) {
+    uint64_t size = 0;
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status)) size = status.ullAvailPhys;
+#else
+#ifdef __linux__
+    size = _my_sysinfo_meminfo_available();
+#endif
+    long pageSize = sysconf(_SC_PAGESIZE);
+#ifdef _SC_AVPHYS_PAGES
+    long pages = sysconf(_SC_AVPHYS_PAGES);
+#else
+    long pages = sysconf(_SC_PHYS_PAGES); // e.g. macOS, no available pages info, use total instead
+#endif
+    if (size == 0 && pageSize > 0 && pages > 0) size = (uint64_t)pageSize * (uint64_t)pages; // fallback
+#endif
+    if (size > SIZE_MAX) size = SIZE_MAX; // 32-bits platform
+    return (size_t)size;
+}
+
+#ifdef __linux__
+// read "<quota> <period>" from cgroup v2 'cpu.max', or 'cpu.cfs_quota_us' + 'cpu.cfs_period_us' of cgroup v1,
+// return CPU count allowed by the quota (rounded up), or 0 if no limit
+static int _my_sysinfo_cgroup_read_quota(const char* quotaPath, const char* periodPath) {
+    long long quota = -1, period = 0;
+    FILE* fp = fopen(quotaPath, "r");
+    if (fp == NULL) return 0;
+    int n = fscanf(fp, "%lld %lld", &quota, &period); // "max 100000" fails to parse 'quota', means no limit
+    fclose(fp);
+    if (n < 1) return 0;
+    if (periodPath) {
+        fp = fopen(periodPath, "r");
+        if (fp == NULL) return 0;
+        if (fscanf(fp, "%lld", &period) != 1) period = 0;
+        fclose(fp);
+    }
+    if (quota <= 0 || period <= 0) return 0;
+    return (int)((quota + period - 1) / period);
+}
+
+// CPU count allowed by cgroup CPU quota (e.g. docker --cpus, kubernetes cpu limits), or 0 if no limit
+static int _my_sysinfo_cgroup_cpu_limit(void) {
+    // cgroup v2: "0::/path/of/cgroup" in /proc/self/cgroup,
+    // the quota may be set on any parent cgroup, so use the smallest one of all levels
+    char cgroupPath[512] = "";
+    FILE* fp = fopen("/proc/self/cgroup", "r");
+    if (fp) {
+        char line[512];
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "0::", 3) != 0) continue;
+            line[strcspn(line, "\r\n")] = '\0';
+            snprintf(cgroupPath, sizeof(cgroupPath), "%s", strcmp(line + 3, "/") == 0 ? "" : line + 3);
+            break;
+        }
+        fclose(fp);
+    }
+
+    int limit = 0;
+    char path[600];
+    for (;;) {
+        snprintf(path, sizeof(path), "/sys/fs/cgroup%s/cpu.max", cgroupPath);
+        int n = _my_sysinfo_cgroup_read_quota(path, NULL);
+        if (n > 0 && (limit == 0 || n < limit)) limit = n;
+        char* p = strrchr(cgroupPath, '/');
+        if (p == NULL) break;
+        *p = '\0';
+    }
+    if (limit > 0) return limit;
+
+    // cgroup v1, inside container the cgroup of the process is mounted as root
+    limit = _my_sysinfo_cgroup_read_quota("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+    if (limit == 0) limit = _my_sysinfo_cgroup_read_quota("/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_quota_us", "/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_period_us");
+    return limit;
+}
+#endif
+
+// return count of CPUs this process can really use, at least 1
+// respects CPU affinity (e.g. taskset, start /affinity) and CPU quota (cgroup on linux, job object on windows),
+// unlike the count of all CPUs of the host, which makes too many threads in a container
+int my_sysinfo_get_cpu_count(void) {
+    int count = 0;
+#ifdef _WIN32
+    DWORD_PTR processMask = 0, systemMask = 0;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) && processMask != systemMask) {
+        for (; processMask; processMask &= processMask - 1) count++;
+    }
+    else {
+        count = (int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    }
+
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rate = { 0 };
+    if (QueryInformationJobObject(NULL, JobObjectCpuRateControlInformation, &rate, sizeof(rate), NULL)
+        && (rate.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_ENABLE) && (rate.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP)) {
+        // 'CpuRate' is 1/100 percent of all CPUs of the system
+        int limit = (int)(((uint64_t)rate.CpuRate * GetActiveProcessorCount(ALL_PROCESSOR_GROUPS) + 9999) / 10000);
+        if (limit > 0 && limit < count) count = limit;
+    }
+#else
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) count = CPU_COUNT(&set);
+    int limit = _my_sysinfo_cgroup_cpu_limit();
+    if (count <= 0) count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (limit > 0 && limit < count) count = limit;
+#else
+    count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+#endif
+    return count > 0 ? count : 1;
+}
+
+// return milliseconds from a fixed point, not affected by system time changes
+uint64_t my_sysinfo_get_tick_ms(void) {
+#ifdef _WIN32
+    return GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stddef.h> // size_t
+#include <stdint.h> // uint64_t
+
+size_t my_sysinfo_get_available_memory(void);
+int my_sysinfo_get_cpu_count(void);
+uint64_t my_sysinfo_get_tick_ms(void);
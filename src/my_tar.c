@@ -89,7 +89,7 @@ size_t _tar_checksum(const _tar_header* hdr) {
 // tar dir
 // --------------------------------------------------------------------------
 
-bool _int2OctalStr(size_t value, char* str, int bufSize) {
+bool _int2OctalStr(uint64_t value, char* str, int bufSize) {
     char* p = str + bufSize - 1;
     *p-- = '\0';
     for (;; p--) {
@@ -143,9 +143,9 @@ void _tarDir_writePaxHeader_writeLine(FILE *fp, const char *key, const char *val
     fwrite("\n", 1, 1, fp);
 }
 
-void _tarDir_writePaxHeader_writeLine_IntValue(FILE* fp, const char* key, size_t value, size_t lineSize) {
+void _tarDir_writePaxHeader_writeLine_IntValue(FILE* fp, const char* key, uint64_t value, size_t lineSize) {
     char buf[128];
-    snprintf(buf, sizeof(buf), "%d", (int)value);
+    snprintf(buf, sizeof(buf), "%llu", (unsigned long long)value);
     _tarDir_writePaxHeader_writeLine(fp, key, buf, lineSize);
 }
 
@@ -177,13 +177,13 @@ size_t _tarDir_writePaxHeader_writeLine_getLineSize(const char* key, const char*
     return lineSize;
 }
 
-size_t _tarDir_writePaxHeader_writeLine_IntValue_getLineSize(const char* key, size_t value, size_t keyLen) {
+size_t _tarDir_writePaxHeader_writeLine_IntValue_getLineSize(const char* key, uint64_t value, size_t keyLen) {
     char buf[128];
-    snprintf(buf, sizeof(buf), "%d", (int)value);
+    snprintf(buf, sizeof(buf), "%llu", (unsigned long long)value);
     return _tarDir_writePaxHeader_writeLine_getLineSize(key, buf, keyLen);
 }
 
-void _tarDir_writePaxHeader(FILE* fp, const char* path, size_t size) {
+void _tarDir_writePaxHeader(FILE* fp, const char* path, uint64_t size) {
     // TODO: maybe buggy.............
     // <lineSize> <key>=<value>\n
     size_t lineSize_path = 0;
@@ -283,7 +283,7 @@ int _my_tarDir_onFileFound(const char* path, const char* relPath, NATIVE_FILE_ST
 
     _tar_header hdr = { 0 };
     memcpy(hdr.mode, "0000644\0", 8);
-    size_t fileSize = 0;
+    uint64_t fileSize = 0;
 
     bool bForcePaxHeader = true;
     bool isNormalFile = false;
@@ -410,8 +410,8 @@ char* _gnu_tar_header_read_long_string(FILE* tar, size_t size) {
     fread(str, 1, size, tar);
     return str;
 }
-int _octal2int(char* str, int bufSize) {
-    int v = 0;
+uint64_t _octal2int(char* str, int bufSize) {
+    uint64_t v = 0;
     char ch = *str;
     for (int i = 0; i < bufSize && (ch & 0xF8) == 0x30; str++, ch = *str) { // (ch & 0xF8) == 0x30  equals  ch >= '0' && ch < '8'
         v = (v << 3) | (ch & 0x07); // v = (v << 3) | (ch - '0');
@@ -424,18 +424,18 @@ typedef struct {
     char* linkPath;
 } _my_tar_ext_fields;
 
-int _my_tar_write_file(FILE* tar, char* path, size_t size) {
+int _my_tar_write_file(FILE* tar, char* path, uint64_t size) {
     _my_dir_mkdirs_for_file(path);
 
     char buf[1024 * 8];
-    size_t paddingSize = _round_up_to_512(size) - size;
+    uint64_t paddingSize = _round_up_to_512(size) - size;
     FILE* fp;
     _my_file_fopen(&fp, path, "wb");
     if (fp == NULL) return -1;
     while (size > 0) {
-        size_t tryToReadLen = min(size, sizeof(buf));
-        size_t len = fread(buf, 1, min(size, sizeof(buf)), tar);
-        if (len < 0) {
+        size_t tryToReadLen = (size_t) min(size, (uint64_t) sizeof(buf));
+        size_t len = fread(buf, 1, tryToReadLen, tar);
+        if (len == 0) { // read error, or tar file is truncated
             fclose(fp);
             return -1;
         }
@@ -445,7 +445,7 @@ int _my_tar_write_file(FILE* tar, char* path, size_t size) {
     }
 
     fclose(fp);
-    fseek(tar, (long)paddingSize, SEEK_CUR);
+    my_file_fseek64(tar, (int64_t)paddingSize, SEEK_CUR);
     return 0;
 }
 
@@ -494,26 +494,26 @@ int untarToDir(char* tarPath, char *dirPath) {
         }
 
         // parse headers
-        size_t size = _octal2int(hdr->size, sizeof(hdr->size));
+        uint64_t size = _octal2int(hdr->size, sizeof(hdr->size));
         switch (hdr->typeflag) {
         case 0:
         case '0':
         case '5':
             break;
         case 'L': // GNU long filename header
-            pLongname = _gnu_tar_header_read_long_string(tar, size);
+            pLongname = _gnu_tar_header_read_long_string(tar, (size_t)size);
             hasExtendedHeader = true;
             continue; // read next header
         case 'K': // GNU long linkname header
-            pLongLinkname = _gnu_tar_header_read_long_string(tar, size);
+            pLongLinkname = _gnu_tar_header_read_long_string(tar, (size_t)size);
             hasExtendedHeader = true;
             continue;
         case 'x': // PAX header
-            _pax_tar_header_read_values(tar, size, pMap);
+            _pax_tar_header_read_values(tar, (size_t)size, pMap);
             hasExtendedHeader = true;
             continue; // read next header
         case 'g': // global PAX header
-            _pax_tar_header_read_values(tar, size, pGlobalMap);
+            _pax_tar_header_read_values(tar, (size_t)size, pGlobalMap);
             //hasExtendedHeader = true;
             continue; // read next header
         default:
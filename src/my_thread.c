@@ -123,6 +123,17 @@ int thd_condition_destroy(thd_condition* cond)
     return 0;
 }
 
+static BOOL CALLBACK __internal_once_ptr(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+    (*(thd_once_method*)param)();
+    return TRUE;
+}
+
+int thd_once(thd_once_flag* flag, thd_once_method method)
+{
+    return InitOnceExecuteOnce(flag, __internal_once_ptr, (PVOID)&method, NULL) ? 0 : -1;
+}
+
 #else
 
 #include <errno.h>
@@ -210,4 +221,9 @@ int thd_condition_destroy(thd_condition* cond)
     return pthread_cond_destroy(cond);
 }
 
+int thd_once(thd_once_flag* flag, thd_once_method method)
+{
+    return pthread_once(flag, method);
+}
+
 #endif
\ No newline at end of file
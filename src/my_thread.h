@@ -5,6 +5,8 @@
 	typedef HANDLE thd_thread;
 	typedef CRITICAL_SECTION thd_mutex;
 	typedef CONDITION_VARIABLE thd_condition;
+	typedef INIT_ONCE thd_once_flag;
+	#define THD_ONCE_INIT INIT_ONCE_STATIC_INIT
 #else
 	#include <pthread.h>
     #include <unistd.h> // sleep()
@@ -12,6 +14,8 @@
 	typedef pthread_t thd_thread;
 	typedef pthread_mutex_t thd_mutex;
 	typedef pthread_cond_t thd_condition;
+	typedef pthread_once_t thd_once_flag;
+	#define THD_ONCE_INIT PTHREAD_ONCE_INIT
 #endif
 
 typedef void (*thd_thread_method)(void*);
@@ -38,3 +42,6 @@ int thd_condition_signal_all(thd_condition* cond);
 int thd_condition_wait(thd_condition* cond, thd_mutex* mutex);
 TimedOpResult thd_condition_timedwait(thd_condition* cond, thd_mutex* mutex, size_t timeoutMs);
 int thd_condition_destroy(thd_condition* cond);
+
+typedef void (*thd_once_method)(void);
+int thd_once(thd_once_flag* flag, thd_once_method method); // call [method] only once, even by many threads at the same time
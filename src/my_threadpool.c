@@ -12,17 +12,16 @@ void simple_thread_pool_destroy(SimpleThreadPool* pool) {
 }
 
 int simple_thread_pool_create(SimpleThreadPool *pool, int threadCount, void (*func)(void*), void *param) {
-    pool->num_threads = threadCount;
+    // NOTE: even if failed, caller should call simple_thread_pool_destroy() to wait for the threads already created,
+    //       because these threads may be waiting for data which is provided by caller after this function
+    pool->num_threads = 0;
     pool->threads = (thd_thread*)calloc(threadCount, sizeof(thd_thread));
     if (pool->threads == NULL) return -1;
 
     for (int i = 0; i < threadCount; i++) {
         int err = thd_thread_create(&pool->threads[i], func, param);
-        if (err != 0) {
-            pool->num_threads = i;
-            simple_thread_pool_destroy(pool);
-            return -1;
-        }
+        if (err != 0) return -1;
+        pool->num_threads = i + 1;
     }
     return 0;
 }
@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "my_zip.h"
+#include "my_zip_seek.h"
 #include "my_file.h"
 #include "my_utils.h"
 #include "native_zip.h"
@@ -38,6 +39,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <limits.h> // INT_MAX
 
 // --------------------------------------------------------------------------
 // zip file operation
@@ -142,12 +144,25 @@ FFI_PLUGIN_EXPORT void* readZipFileEntryOpen(void* zip, const char* entryPath) {
     return file;
 }
 
+FFI_PLUGIN_EXPORT int getZipEntryIndex(void* zip, const char* entryPath) {
+    // return index of the entry with exactly the same path, or -1 if not found
+    zip_int64_t index = zip_name_locate((zip_t*)zip, entryPath, 0);
+    return index >= 0 && index <= INT_MAX ? (int)index : -1;
+}
+
 FFI_PLUGIN_EXPORT int readZipFileEntry(void* zipEntryFile, int8_t* buf, int len) {
     // return bytes count read
     zip_file_t* _file = (zip_file_t*)zipEntryFile;
     return (int)zip_fread(_file, buf, len);
 }
 
+FFI_PLUGIN_EXPORT int readZipFileEntrySeek(void* zip, int index, int64_t offset, int8_t* buf, int len) {
+    // return bytes count read from [offset] of entry, 0 if end of entry, or -1 if failed
+    // NOTE: entry is not re-inflated from the beginning for each seek, see my_zip_seek.h
+    if (index < 0 || offset < 0 || len < 0) return -1;
+    return (int)my_zip_seek_read((zip_t*)zip, (zip_uint64_t)index, (uint64_t)offset, buf, (size_t)len);
+}
+
 FFI_PLUGIN_EXPORT int readZipFileEntryClose(void* zipEntryFile) {
     // return 0 if success
     zip_file_t* _file = (zip_file_t*)zipEntryFile;
@@ -166,11 +181,13 @@ int my_zip_get_error(zip_t* zip) {
 
 #undef zip_open
 #undef zip_discard
+#undef zip_close
 
 int my_zip_close(zip_t* zip) {
     // if zip_close() fails, get the real error code, and call zip_discard()
 
     //notifyDartLog("######## zip_close() called");
+    my_zip_seek_release(zip);
     int err = zip_close(zip);
     if (err) {
         zip_error_t* error = zip_get_error(zip);
@@ -186,5 +203,15 @@ zip_t* __zip_open(const char* path, int flags, int* errorp) {
 }
 void __zip_discard(zip_t* zip) {
     //notifyDartLog("######## zip_discard() called");
+    my_zip_seek_release(zip);
     zip_discard(zip);
 }
+int __zip_close(zip_t* zip) {
+    my_zip_seek_release(zip);
+    return zip_close(zip);
+}
+
+// wrappers are used again by sources after this one, when all sources are built as one, see macos/Classes/native_zip.c
+#define zip_open __zip_open
+#define zip_discard __zip_discard
+#define zip_close __zip_close
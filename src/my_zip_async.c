@@ -83,7 +83,7 @@ typedef struct _my_zip_close_task {
 void _zipDirAsync_thread(void *_params) {
     _zip_func_params *params = (_zip_func_params*)_params;
     _my_zip_task* task = (_my_zip_task*) params->task;
-    int err = zipDir(task, params->zip, params->sArr1, params->entriesCount, params->s1, params->skipTopLevel, params->threadCount);
+    int err = zipDir(task, params->zip, params->s2, params->sArr1, params->entriesCount, params->s1, params->skipTopLevel, params->threadCount);
     if (err == 0) err = task->errCode;
     task->progress.now_processing_filePath = (char*)"";
 
@@ -93,13 +93,17 @@ void _zipDirAsync_thread(void *_params) {
 }
 
 // NOTE: will call zip_close() or zip_discard()
-FFI_PLUGIN_EXPORT void* zipDirAsync(void* _zip, bool hasPassword, const char** dirPathList, int dirPathListCount, const char* entryDirPathBase, int compressLevel, int skipTopLevel, int threadCount) {
+FFI_PLUGIN_EXPORT void* zipDirAsync(void* _zip, const char* zipFilePath, const char* password, const char** dirPathList, int dirPathListCount, const char* entryDirPathBase, int compressLevel, int compressMethod, int skipTopLevel, int threadCount, int64_t maxBlockSize, int64_t maxMemoryUsage, int flags) {
     zip_t *zip = (zip_t*)_zip;
     _my_zip_task* task = (_my_zip_task*) calloc(1, sizeof(_my_zip_task));
     task->taskId = generateTaskId();
     task->progress.now_processing_filePath = (char*) "";
-    task->hasPassword = hasPassword;
+    task->password = password;
     task->compressLevel = compressLevel;
+    task->compressMethod = compressMethod;
+    task->flags = flags;
+    task->maxBlockSize = maxBlockSize > 0 ? (size_t)maxBlockSize : 0; // 0 means auto
+    task->maxMemoryUsage = maxMemoryUsage > 0 ? (size_t)maxMemoryUsage : 0;
 
     _zip_func_params *params = (_zip_func_params*) malloc(sizeof(_zip_func_params));
     params->task = task;
@@ -108,6 +112,7 @@ FFI_PLUGIN_EXPORT void* zipDirAsync(void* _zip, bool hasPassword, const char** d
     params->sArr1 = dirPathList;
     params->entriesCount = dirPathListCount;
     params->s1 = entryDirPathBase;
+    params->s2 = zipFilePath;
     params->skipTopLevel = skipTopLevel;
     params->threadCount = threadCount;
     
@@ -137,12 +142,13 @@ void _unzipToDirAsync_thread(void *_params) {
 }
 
 // NOTE: won't call zip_close() or zip_discard()
-FFI_PLUGIN_EXPORT void* unzipToDirAsync(void* _zip, const char *password, const char *zipFilePath, const char **entryPathsArr, int entriesCount, const char *toDirPath, int threadCount) {
+FFI_PLUGIN_EXPORT void* unzipToDirAsync(void* _zip, const char *password, const char *zipFilePath, const char **entryPathsArr, int entriesCount, const char *toDirPath, int threadCount, int flags) {
     zip_t *zip = (zip_t*)_zip;
     _my_unzip_task* task = (_my_unzip_task*) calloc(1, sizeof(_my_unzip_task));
     task->taskId = generateTaskId();
     task->progress.now_processing_filePath = (char*) "";
     task->password = password;
+    task->flags = flags;
 
     _zip_func_params *params = (_zip_func_params*) malloc(sizeof(_zip_func_params));
     params->task = task;
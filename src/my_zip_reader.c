@@ -0,0 +1,264 @@
+#include "my_zip_reader.h"
+#include "my_zip_writer.h" // MY_ZIP_EXTRA_BLOCK_INDEX
+#include "my_file.h"
+#include "my_common.h"
+
+#include <zip.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ref: https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+
+#define ZIP_SIG_LOCAL_HEADER 0x04034b50
+#define ZIP_SIG_CENTRAL_HEADER 0x02014b50
+#define ZIP_SIG_EOCD 0x06054b50
+#define ZIP_SIG_ZIP64_EOCD 0x06064b50
+#define ZIP_SIG_ZIP64_EOCD_LOCATOR 0x07064b50
+
+#define ZIP_LOCAL_HEADER_SIZE 30
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_EOCD_SIZE 22
+#define ZIP_ZIP64_EOCD_SIZE 56
+#define ZIP_ZIP64_EOCD_LOCATOR_SIZE 20
+#define ZIP_MAX_COMMENT_SIZE 0xFFFF
+#define ZIP_EXTRA_ZIP64 0x0001
+#define ZIP_EXTRA_UNICODE_PATH 0x7075
+
+#define ZIP_MAX_16 0xFFFF
+#define ZIP_MAX_32 0xFFFFFFFFULL
+
+static uint16_t _get16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t _get32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t _get64(const uint8_t* p) {
+    return (uint64_t)_get32(p) | ((uint64_t)_get32(p + 4) << 32);
+}
+
+// find end of central directory record, return its offset in the file
+static int _my_zip_reader_find_eocd(MyZipReader* reader, uint64_t fileSize, uint8_t* eocd, uint64_t* pOffset) {
+    if (fileSize < ZIP_EOCD_SIZE) return ZIP_ER_NOZIP;
+    size_t len = (size_t)(fileSize < ZIP_EOCD_SIZE + ZIP_MAX_COMMENT_SIZE ? fileSize : ZIP_EOCD_SIZE + ZIP_MAX_COMMENT_SIZE);
+    uint64_t start = fileSize - len;
+    uint8_t* buf = (uint8_t*)malloc(len);
+    if (buf == NULL) return ZIP_ER_MEMORY;
+    if (my_file_pread(reader->fd, buf, len, start) != 0) {
+        free(buf);
+        return ZIP_ER_READ;
+    }
+
+    // search backward, the record is followed by the archive comment
+    int err = ZIP_ER_NOZIP;
+    for (size_t i = len - ZIP_EOCD_SIZE + 1; i-- > 0;) {
+        if (_get32(buf + i) != ZIP_SIG_EOCD) continue;
+        if (i + ZIP_EOCD_SIZE + _get16(buf + i + 20) != len) continue; // comment length mismatch, maybe data of comment
+        memcpy(eocd, buf + i, ZIP_EOCD_SIZE);
+        *pOffset = start + i;
+        err = 0;
+        break;
+    }
+    free(buf);
+    return err;
+}
+
+// read the location of central directory from zip64 end of central directory record, if it exists
+static int _my_zip_reader_read_zip64_eocd(MyZipReader* reader, uint64_t eocdOffset, uint64_t* pCount, uint64_t* pCdSize, uint64_t* pCdOffset) {
+    if (eocdOffset < ZIP_ZIP64_EOCD_LOCATOR_SIZE) return 0;
+    uint8_t locator[ZIP_ZIP64_EOCD_LOCATOR_SIZE];
+    if (my_file_pread(reader->fd, locator, sizeof(locator), eocdOffset - ZIP_ZIP64_EOCD_LOCATOR_SIZE) != 0) return ZIP_ER_READ;
+    if (_get32(locator) != ZIP_SIG_ZIP64_EOCD_LOCATOR) return 0; // not zip64
+
+    uint8_t rec[ZIP_ZIP64_EOCD_SIZE];
+    if (my_file_pread(reader->fd, rec, sizeof(rec), _get64(locator + 8)) != 0) return ZIP_ER_READ;
+    if (_get32(rec) != ZIP_SIG_ZIP64_EOCD) return ZIP_ER_INCONS;
+    *pCount = _get64(rec + 32);
+    *pCdSize = _get64(rec + 40);
+    *pCdOffset = _get64(rec + 48);
+    return 0;
+}
+
+// keep a copy of MY_ZIP_EXTRA_BLOCK_INDEX data in 'reader->blockIndexes'
+static int _my_zip_reader_add_block_index(MyZipReader* reader, MyZipReaderEntry* entry, const uint8_t* data, size_t len) {
+    uint8_t* p = (uint8_t*)realloc(reader->blockIndexes, reader->blockIndexesLen + len);
+    if (p == NULL) return ZIP_ER_MEMORY;
+    memcpy(p + reader->blockIndexesLen, data, len);
+    reader->blockIndexes = p;
+    entry->blockIndexOffset = reader->blockIndexesLen;
+    entry->blockIndexLen = (uint16_t)len;
+    reader->blockIndexesLen += len;
+    return 0;
+}
+
+// replace 0xFFFFFFFF fields of central header by values in zip64 extra field, and find MY_ZIP_EXTRA_BLOCK_INDEX / unicode path
+static int _my_zip_reader_parse_extra(MyZipReader* reader, MyZipReaderEntry* entry, const uint8_t* extra, size_t extraLen) {
+    while (extraLen >= 4) {
+        uint16_t id = _get16(extra);
+        size_t len = _get16(extra + 2);
+        if (len > extraLen - 4) break;
+        if (id == ZIP_EXTRA_ZIP64) {
+            const uint8_t* p = extra + 4;
+            const uint8_t* end = p + len;
+            if (entry->uncompressedSize == ZIP_MAX_32 && p + 8 <= end) { entry->uncompressedSize = _get64(p); p += 8; }
+            if (entry->compressedSize == ZIP_MAX_32 && p + 8 <= end) { entry->compressedSize = _get64(p); p += 8; }
+            if (entry->localHeaderOffset == ZIP_MAX_32 && p + 8 <= end) entry->localHeaderOffset = _get64(p);
+        }
+        else if (id == ZIP_EXTRA_UNICODE_PATH) {
+            entry->hasUnicodePath = true;
+        }
+        else if (id == MY_ZIP_EXTRA_BLOCK_INDEX && len > 0) {
+            int err = _my_zip_reader_add_block_index(reader, entry, extra + 4, len);
+            if (err) return err;
+        }
+        extra += 4 + len;
+        extraLen -= 4 + len;
+    }
+    return 0;
+}
+
+static int _my_zip_reader_parse_central_directory(MyZipReader* reader, const uint8_t* cd, size_t cdSize, uint64_t count) {
+    // NOTE: each record is at least 46 bytes, so a broken count cannot allocate too much memory
+    if (count > cdSize / ZIP_CENTRAL_HEADER_SIZE) return ZIP_ER_INCONS;
+    reader->entries = (MyZipReaderEntry*)malloc((size_t)(count ? count : 1) * sizeof(MyZipReaderEntry));
+    reader->names = (char*)malloc(cdSize ? cdSize : 1); // names are shorter than central directory
+    if (reader->entries == NULL || reader->names == NULL) return ZIP_ER_MEMORY;
+
+    size_t pos = 0;
+    size_t namesLen = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        if (cdSize - pos < ZIP_CENTRAL_HEADER_SIZE) return ZIP_ER_INCONS;
+        const uint8_t* hdr = cd + pos;
+        if (_get32(hdr) != ZIP_SIG_CENTRAL_HEADER) return ZIP_ER_INCONS;
+        size_t nameLen = _get16(hdr + 28);
+        size_t extraLen = _get16(hdr + 30);
+        size_t commentLen = _get16(hdr + 32);
+        size_t recordLen = ZIP_CENTRAL_HEADER_SIZE + nameLen + extraLen + commentLen;
+        if (cdSize - pos < recordLen) return ZIP_ER_INCONS;
+
+        MyZipReaderEntry* entry = &reader->entries[i];
+        entry->flags = _get16(hdr + 8);
+        entry->method = _get16(hdr + 10);
+        entry->dosTime = _get16(hdr + 12);
+        entry->dosDate = _get16(hdr + 14);
+        entry->crc = _get32(hdr + 16);
+        entry->compressedSize = _get32(hdr + 20);
+        entry->uncompressedSize = _get32(hdr + 24);
+        entry->localHeaderOffset = _get32(hdr + 42);
+        entry->blockIndexLen = 0;
+        entry->blockIndexOffset = 0;
+        entry->hasUnicodePath = false;
+        int err = _my_zip_reader_parse_extra(reader, entry, hdr + ZIP_CENTRAL_HEADER_SIZE + nameLen, extraLen);
+        if (err) return err;
+
+        entry->nameOffset = namesLen;
+        memcpy(reader->names + namesLen, hdr + ZIP_CENTRAL_HEADER_SIZE, nameLen);
+        namesLen += nameLen;
+        reader->names[namesLen++] = '\0';
+        pos += recordLen;
+    }
+    reader->entriesCount = count;
+    return 0;
+}
+
+int my_zip_reader_open(MyZipReader* reader, const char* path) {
+    memset(reader, 0, sizeof(MyZipReader));
+    NATIVE_FILE_STAT st;
+    if (my_file_stat(path, &st) != 0) return ZIP_ER_OPEN;
+    reader->fd = my_file_open_read_shared(path); // read by all unzip threads
+    if (reader->fd == MY_FILE_INVALID_HANDLE) return ZIP_ER_OPEN;
+
+    uint8_t eocd[ZIP_EOCD_SIZE];
+    uint64_t eocdOffset = 0;
+    int err = _my_zip_reader_find_eocd(reader, (uint64_t)st.st_size, eocd, &eocdOffset);
+    uint64_t count = _get16(eocd + 10);
+    uint64_t cdSize = _get32(eocd + 12);
+    uint64_t cdOffset = _get32(eocd + 16);
+    if (err == 0 && (count == ZIP_MAX_16 || cdSize == ZIP_MAX_32 || cdOffset == ZIP_MAX_32)) {
+        err = _my_zip_reader_read_zip64_eocd(reader, eocdOffset, &count, &cdSize, &cdOffset);
+    }
+    if (err == 0 && (cdOffset > eocdOffset || cdSize > eocdOffset - cdOffset || cdSize > SIZE_MAX)) err = ZIP_ER_INCONS;
+
+    uint8_t* cd = NULL;
+    if (err == 0) {
+        cd = (uint8_t*)malloc((size_t)(cdSize ? cdSize : 1));
+        if (cd == NULL) err = ZIP_ER_MEMORY;
+    }
+    if (err == 0 && my_file_pread(reader->fd, cd, (size_t)cdSize, cdOffset) != 0) err = ZIP_ER_READ;
+    if (err == 0) err = _my_zip_reader_parse_central_directory(reader, cd, (size_t)cdSize, count);
+    free(cd);
+
+    if (err != 0) my_zip_reader_close(reader);
+    return err;
+}
+
+void my_zip_reader_close(MyZipReader* reader) {
+    my_file_close(reader->fd);
+    reader->fd = MY_FILE_INVALID_HANDLE;
+    FREEIF(reader->entries);
+    FREEIF(reader->names);
+    FREEIF(reader->blockIndexes);
+    reader->blockIndexesLen = 0;
+    reader->entriesCount = 0;
+}
+
+const char* my_zip_reader_name(const MyZipReader* reader, uint64_t index) {
+    return reader->names + reader->entries[index].nameOffset;
+}
+
+// dos time is local time, the same as libzip
+time_t my_zip_reader_mtime(const MyZipReaderEntry* entry) {
+    struct tm tmv;
+    memset(&tmv, 0, sizeof(tmv));
+    tmv.tm_year = ((entry->dosDate >> 9) & 0x7F) + 80;
+    tmv.tm_mon = ((entry->dosDate >> 5) & 0x0F) - 1;
+    tmv.tm_mday = entry->dosDate & 0x1F;
+    tmv.tm_hour = (entry->dosTime >> 11) & 0x1F;
+    tmv.tm_min = (entry->dosTime >> 5) & 0x3F;
+    tmv.tm_sec = (entry->dosTime << 1) & 0x3E;
+    tmv.tm_isdst = -1;
+    return mktime(&tmv);
+}
+
+// NOTE: name and extra field in local header may be different from central directory, so read the local header
+int my_zip_reader_data_offset(const MyZipReader* reader, uint64_t index, uint64_t* pOffset) {
+    const MyZipReaderEntry* entry = &reader->entries[index];
+    uint8_t hdr[ZIP_LOCAL_HEADER_SIZE];
+    if (my_file_pread(reader->fd, hdr, sizeof(hdr), entry->localHeaderOffset) != 0) return ZIP_ER_READ;
+    if (_get32(hdr) != ZIP_SIG_LOCAL_HEADER) return ZIP_ER_INCONS;
+    *pOffset = entry->localHeaderOffset + ZIP_LOCAL_HEADER_SIZE + _get16(hdr + 26) + _get16(hdr + 28);
+    return 0;
+}
+
+// the block index is only trusted if it exactly matches the entry
+bool my_zip_reader_block_index(const MyZipReader* reader, uint64_t index, MyZipBlockIndex* blockIndex) {
+    const MyZipReaderEntry* entry = &reader->entries[index];
+    if (entry->blockIndexLen < MY_ZIP_BLOCK_INDEX_HEADER_SIZE) return false;
+    if (entry->method != ZIP_CM_DEFLATE || (entry->flags & MY_ZIP_FLAG_ENCRYPTED)) return false;
+
+    const uint8_t* data = reader->blockIndexes + entry->blockIndexOffset;
+    uint64_t blockSize = _get64(data + 1);
+    uint32_t count = _get32(data + 9);
+    if (data[0] != MY_ZIP_BLOCK_INDEX_VERSION || blockSize == 0 || count < 2) return false;
+    if (entry->blockIndexLen != MY_ZIP_BLOCK_INDEX_HEADER_SIZE + (size_t)count * MY_ZIP_BLOCK_INDEX_ITEM_SIZE) return false;
+    if (entry->uncompressedSize / blockSize + (entry->uncompressedSize % blockSize != 0) != count) return false;
+
+    blockIndex->blockSize = blockSize;
+    blockIndex->count = count;
+    blockIndex->items = data + MY_ZIP_BLOCK_INDEX_HEADER_SIZE;
+    uint64_t compressedSize = 0;
+    for (uint32_t i = 0; i < count; i++) compressedSize += my_zip_block_index_compressed_size(blockIndex, i);
+    return compressedSize == entry->compressedSize;
+}
+
+uint32_t my_zip_block_index_compressed_size(const MyZipBlockIndex* blockIndex, uint32_t i) {
+    return _get32(blockIndex->items + (size_t)i * MY_ZIP_BLOCK_INDEX_ITEM_SIZE);
+}
+
+uint32_t my_zip_block_index_crc(const MyZipBlockIndex* blockIndex, uint32_t i) {
+    return _get32(blockIndex->items + (size_t)i * MY_ZIP_BLOCK_INDEX_ITEM_SIZE + 4);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "my_file.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+// --------------------------------------------------------------------------
+// a minimal read-only .zip central directory parser, used by unzipToDir(),
+// the central directory is parsed once and shared by all threads (never changed after opened),
+// and entry data is read by positioned reads on the shared file handle, so threads don't zip_open() the file again
+// --------------------------------------------------------------------------
+
+#define MY_ZIP_FLAG_ENCRYPTED 0x0001 // general purpose bit 0
+#define MY_ZIP_FLAG_UTF8 0x0800 // general purpose bit 11: name is utf-8
+
+typedef struct MyZipReaderEntry {
+    uint64_t compressedSize;
+    uint64_t uncompressedSize;
+    uint64_t localHeaderOffset;
+    size_t nameOffset; // offset of the name in 'MyZipReader->names'
+    uint32_t crc;
+    uint16_t method;
+    uint16_t flags; // general purpose bit flag
+    uint16_t dosTime;
+    uint16_t dosDate;
+    uint16_t blockIndexLen; // length of MY_ZIP_EXTRA_BLOCK_INDEX data, 0 if not exists
+    size_t blockIndexOffset; // offset of MY_ZIP_EXTRA_BLOCK_INDEX data in 'MyZipReader->blockIndexes'
+    bool hasUnicodePath; // Info-ZIP Unicode Path extra field exists, the real name may not be the raw name (not parsed here)
+} MyZipReaderEntry;
+
+typedef struct MyZipBlockIndex { // blocks of an entry written by zipDir() with NZ_FLAG_BLOCK_INDEX, see MY_ZIP_EXTRA_BLOCK_INDEX
+    uint64_t blockSize; // uncompressed size of each block, except the last one
+    uint32_t count;
+    const uint8_t* items; // [count] * (compressedSize(4) | crc(4))
+} MyZipBlockIndex;
+
+typedef struct MyZipReader {
+    MyFileHandle fd;
+    uint64_t entriesCount;
+    MyZipReaderEntry* entries; // in the order of central directory, the same as entry index of libzip
+    char* names; // names of all entries, each ends with '\0'
+    uint8_t* blockIndexes; // data of MY_ZIP_EXTRA_BLOCK_INDEX of all entries
+    size_t blockIndexesLen;
+} MyZipReader;
+
+int my_zip_reader_open(MyZipReader* reader, const char* path);
+void my_zip_reader_close(MyZipReader* reader);
+const char* my_zip_reader_name(const MyZipReader* reader, uint64_t index);
+time_t my_zip_reader_mtime(const MyZipReaderEntry* entry);
+int my_zip_reader_data_offset(const MyZipReader* reader, uint64_t index, uint64_t* pOffset); // offset of entry data, after local header
+bool my_zip_reader_block_index(const MyZipReader* reader, uint64_t index, MyZipBlockIndex* blockIndex); // false if no valid block index
+uint32_t my_zip_block_index_compressed_size(const MyZipBlockIndex* blockIndex, uint32_t i);
+uint32_t my_zip_block_index_crc(const MyZipBlockIndex* blockIndex, uint32_t i);
@@ -0,0 +1,323 @@
+#include "my_zip_seek.h"
+#include "my_thread.h"
+#include "my_common.h"
+
+#include <zlib.h>
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h> // SEEK_SET
+
+#define min(a,b) (((a) < (b)) ? (a) : (b))
+#define max(a,b) (((a) > (b)) ? (a) : (b))
+
+#define ZIP_SEEK_WINDOW_SIZE 32768
+#define ZIP_SEEK_MIN_SPAN ((uint64_t)1024 * 1024) // uncompressed bytes between checkpoints
+#define ZIP_SEEK_MAX_POINTS 1024 // at most 32MB of windows for each entry, so the span of huge entries is larger
+#define ZIP_SEEK_BUFFER_SIZE (1024 * 16)
+#define ZIP_SEEK_MAX_ENTRIES 8 // least recently used entries not in use are freed
+#define ZIP_SEEK_MAX_MEMORY ((size_t)64 * 1024 * 1024) // windows of all checkpoints, no more checkpoints recorded if exceeded
+
+typedef struct _my_zip_seek_point {
+    uint64_t out; // offset in uncompressed data
+    uint64_t in; // offset in compressed data, the first byte not consumed yet
+    int bits; // if not 0, the lowest bits of byte at 'in - 1' are not consumed yet
+    unsigned int windowLen;
+    uint8_t* window; // the last 32KB of uncompressed data before 'out'
+} _my_zip_seek_point;
+
+typedef struct _my_zip_seek_entry {
+    zip_t* zip;
+    zip_uint64_t index;
+    thd_mutex mutex;
+    uint64_t size;
+    bool isInflate; // deflate entry without encryption, read by ZIP_FL_COMPRESSED and inflated by ourselves
+    uint64_t span;
+    _my_zip_seek_point* points; // sorted by 'out'
+    size_t pointsCount;
+    size_t pointsCapacity;
+
+    // cursor, where the last read ends
+    zip_file_t* zf; // NULL if not opened
+    z_stream stream;
+    uint64_t out; // offset in uncompressed data
+    uint64_t in; // compressed bytes read from 'zf'
+    uint8_t inBuf[ZIP_SEEK_BUFFER_SIZE];
+
+    int refs; // readers using this entry, it is not freed if > 0, protected by '__seek_mutex'
+    size_t memory; // windows of 'points', protected by '__seek_mutex'
+    struct _my_zip_seek_entry* next;
+} _my_zip_seek_entry;
+
+static _my_zip_seek_entry* __seek_entries = NULL; // most recently used first
+static size_t __seek_entries_count = 0;
+static size_t __seek_memory = 0; // windows of all entries
+static thd_mutex __seek_mutex; // protect all above
+static thd_once_flag __seek_once = THD_ONCE_INIT;
+
+static void _my_zip_seek_mutex_init(void) {
+    thd_mutex_init(&__seek_mutex);
+}
+
+static void _my_zip_seek_lock(void) {
+    thd_once(&__seek_once, _my_zip_seek_mutex_init);
+    thd_mutex_lock(&__seek_mutex);
+}
+
+static _my_zip_seek_entry* _my_zip_seek_entry_create(zip_t* zip, zip_uint64_t index) {
+    struct zip_stat st;
+    if (zip_stat_index(zip, index, 0, &st) != 0 || !(st.valid & ZIP_STAT_SIZE)) return NULL;
+    _my_zip_seek_entry* e = (_my_zip_seek_entry*)calloc(1, sizeof(_my_zip_seek_entry));
+    if (e == NULL) return NULL;
+    e->zip = zip;
+    e->index = index;
+    e->size = st.size;
+    e->isInflate = (st.valid & ZIP_STAT_COMP_METHOD) && st.comp_method == ZIP_CM_DEFLATE
+        && (st.valid & ZIP_STAT_ENCRYPTION_METHOD) && st.encryption_method == ZIP_EM_NONE;
+    if (e->isInflate && inflateInit2(&e->stream, -MAX_WBITS) != Z_OK) {
+        free(e);
+        return NULL;
+    }
+    e->span = max(ZIP_SEEK_MIN_SPAN, e->size / ZIP_SEEK_MAX_POINTS);
+    thd_mutex_init(&e->mutex);
+    return e;
+}
+
+static void _my_zip_seek_entry_free(_my_zip_seek_entry* e) {
+    if (e->zf) zip_fclose(e->zf);
+    if (e->isInflate) inflateEnd(&e->stream);
+    for (size_t i = 0; i < e->pointsCount; i++) free(e->points[i].window);
+    free(e->points);
+    thd_mutex_destroy(&e->mutex);
+    free(e);
+}
+
+// unlink [*pe] from the list and free it, '__seek_mutex' must be locked
+static void _my_zip_seek_entry_remove(_my_zip_seek_entry** pe) {
+    _my_zip_seek_entry* e = *pe;
+    *pe = e->next;
+    __seek_entries_count--;
+    __seek_memory -= e->memory;
+    _my_zip_seek_entry_free(e);
+}
+
+// free the least recently used entries not in use, until the cache is small enough, '__seek_mutex' must be locked
+static void _my_zip_seek_evict(void) {
+    while (__seek_entries_count > ZIP_SEEK_MAX_ENTRIES || __seek_memory > ZIP_SEEK_MAX_MEMORY) {
+        _my_zip_seek_entry** victim = NULL;
+        for (_my_zip_seek_entry** pe = &__seek_entries; *pe; pe = &(*pe)->next) {
+            if ((*pe)->refs == 0) victim = pe;
+        }
+        if (victim == NULL) break; // all in use
+        _my_zip_seek_entry_remove(victim);
+    }
+}
+
+// the returned entry is not freed until _my_zip_seek_entry_put()
+static _my_zip_seek_entry* _my_zip_seek_entry_get(zip_t* zip, zip_uint64_t index) {
+    _my_zip_seek_lock();
+    _my_zip_seek_entry** pe = &__seek_entries;
+    while (*pe && ((*pe)->zip != zip || (*pe)->index != index)) pe = &(*pe)->next;
+    _my_zip_seek_entry* e = *pe;
+    if (e) *pe = e->next; // move to the head
+    else if ((e = _my_zip_seek_entry_create(zip, index)) != NULL) __seek_entries_count++;
+    if (e) {
+        e->next = __seek_entries;
+        __seek_entries = e;
+        e->refs++;
+        _my_zip_seek_evict();
+    }
+    thd_mutex_unlock(&__seek_mutex);
+    return e;
+}
+
+static void _my_zip_seek_entry_put(_my_zip_seek_entry* e) {
+    _my_zip_seek_lock();
+    e->refs--;
+    thd_mutex_unlock(&__seek_mutex);
+}
+
+// reserve memory of a window for [e], return false if the cache is full
+static bool _my_zip_seek_reserve(_my_zip_seek_entry* e, bool isReserve) {
+    bool isOk = true;
+    _my_zip_seek_lock();
+    if (!isReserve) {
+        __seek_memory -= ZIP_SEEK_WINDOW_SIZE;
+        e->memory -= ZIP_SEEK_WINDOW_SIZE;
+    }
+    else if (__seek_memory + ZIP_SEEK_WINDOW_SIZE > ZIP_SEEK_MAX_MEMORY) {
+        isOk = false;
+    }
+    else {
+        __seek_memory += ZIP_SEEK_WINDOW_SIZE;
+        e->memory += ZIP_SEEK_WINDOW_SIZE;
+    }
+    thd_mutex_unlock(&__seek_mutex);
+    return isOk;
+}
+
+// record a checkpoint at the end of a deflate block, if far enough from the last one
+// NOTE: not an error if failed, just seek slower
+static void _my_zip_seek_add_point(_my_zip_seek_entry* e) {
+    uint64_t lastOut = e->pointsCount > 0 ? e->points[e->pointsCount - 1].out : 0;
+    if (e->out < lastOut + e->span) return;
+    if (e->pointsCount == e->pointsCapacity) {
+        size_t capacity = e->pointsCapacity ? e->pointsCapacity * 2 : 16;
+        _my_zip_seek_point* points = (_my_zip_seek_point*)realloc(e->points, capacity * sizeof(_my_zip_seek_point));
+        if (points == NULL) return;
+        e->points = points;
+        e->pointsCapacity = capacity;
+    }
+    if (!_my_zip_seek_reserve(e, true)) return;
+    _my_zip_seek_point* p = &e->points[e->pointsCount];
+    p->window = (uint8_t*)malloc(ZIP_SEEK_WINDOW_SIZE);
+    uInt windowLen = 0;
+    if (p->window == NULL || inflateGetDictionary(&e->stream, p->window, &windowLen) != Z_OK) {
+        free(p->window);
+        _my_zip_seek_reserve(e, false);
+        return;
+    }
+    p->windowLen = windowLen;
+    p->out = e->out;
+    p->in = e->in - e->stream.avail_in;
+    p->bits = e->stream.data_type & 7;
+    e->pointsCount++;
+}
+
+// the last checkpoint before [offset], NULL if not exists
+static const _my_zip_seek_point* _my_zip_seek_find_point(const _my_zip_seek_entry* e, uint64_t offset) {
+    size_t lo = 0, hi = e->pointsCount;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (e->points[mid].out <= offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo > 0 ? &e->points[lo - 1] : NULL;
+}
+
+// read from cursor, and record checkpoints while inflating
+static int64_t _my_zip_seek_read_forward(_my_zip_seek_entry* e, void* buf, size_t len) {
+    if (!e->isInflate) {
+        zip_int64_t n = zip_fread(e->zf, buf, len);
+        if (n > 0) e->out += n;
+        return n;
+    }
+
+    z_stream* stream = &e->stream;
+    stream->next_out = (Bytef*)buf;
+    stream->avail_out = (uInt)len;
+    while (stream->avail_out > 0 && e->out < e->size) {
+        if (stream->avail_in == 0) {
+            zip_int64_t n = zip_fread(e->zf, e->inBuf, sizeof(e->inBuf));
+            if (n <= 0) return -1; // truncated
+            e->in += n;
+            stream->next_in = e->inBuf;
+            stream->avail_in = (uInt)n;
+        }
+        uInt outLen = stream->avail_out;
+        int ret = inflate(stream, Z_BLOCK);
+        e->out += outLen - stream->avail_out;
+        if (ret == Z_STREAM_END) {
+            if (e->out != e->size) return -1;
+            break;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR) return -1;
+        if ((stream->data_type & 128) && !(stream->data_type & 64)) _my_zip_seek_add_point(e); // end of a block, not the last one
+    }
+    return (int64_t)(len - stream->avail_out);
+}
+
+// skip compressed data to [in]
+static int _my_zip_seek_skip_input(_my_zip_seek_entry* e, uint64_t in) {
+    if (in == 0) return 0;
+    if (zip_fseek(e->zf, (zip_int64_t)in, SEEK_SET) == 0) {
+        e->in = in;
+        return 0;
+    }
+    while (e->in < in) { // not seekable, e.g. libzip is too old
+        zip_int64_t n = zip_fread(e->zf, e->inBuf, min(sizeof(e->inBuf), in - e->in));
+        if (n <= 0) return -1;
+        e->in += n;
+    }
+    return 0;
+}
+
+// (re)open cursor at the beginning of entry, or at checkpoint [p]
+static int _my_zip_seek_open(_my_zip_seek_entry* e, const _my_zip_seek_point* p) {
+    if (e->zf) zip_fclose(e->zf);
+    e->zf = zip_fopen_index(e->zip, e->index, e->isInflate ? ZIP_FL_COMPRESSED : 0);
+    if (e->zf == NULL) return -1;
+    e->in = 0;
+    e->out = 0;
+    if (!e->isInflate) return 0;
+
+    z_stream* stream = &e->stream;
+    if (inflateReset(stream) != Z_OK) return -1;
+    stream->avail_in = 0;
+    if (p == NULL) return 0;
+
+    if (_my_zip_seek_skip_input(e, p->in - (p->bits ? 1 : 0)) != 0) return -1;
+    if (p->bits) {
+        uint8_t ch;
+        if (zip_fread(e->zf, &ch, 1) != 1) return -1;
+        e->in++;
+        if (inflatePrime(stream, p->bits, ch >> (8 - p->bits)) != Z_OK) return -1;
+    }
+    if (inflateSetDictionary(stream, p->window, p->windowLen) != Z_OK) return -1;
+    e->out = p->out;
+    return 0;
+}
+
+// move cursor to [offset]
+static int _my_zip_seek_to(_my_zip_seek_entry* e, uint64_t offset) {
+    if (e->zf && e->out == offset) return 0;
+    if (!e->isInflate && e->zf && zip_fseek(e->zf, (zip_int64_t)offset, SEEK_SET) == 0) { // e.g. stored entry
+        e->out = offset;
+        return 0;
+    }
+
+    bool isForward = e->zf && e->out <= offset;
+    const _my_zip_seek_point* p = e->isInflate ? _my_zip_seek_find_point(e, offset) : NULL;
+    if (p && (!isForward || p->out > e->out)) { // nearer than cursor
+        if (_my_zip_seek_open(e, p) != 0) return -1;
+    }
+    else if (!isForward && _my_zip_seek_open(e, NULL) != 0) {
+        return -1;
+    }
+
+    uint8_t buf[ZIP_SEEK_BUFFER_SIZE];
+    while (e->out < offset) {
+        int64_t n = _my_zip_seek_read_forward(e, buf, (size_t)min(sizeof(buf), offset - e->out));
+        if (n <= 0) return -1;
+    }
+    return 0;
+}
+
+int64_t my_zip_seek_read(zip_t* zip, zip_uint64_t index, uint64_t offset, void* buf, size_t len) {
+    _my_zip_seek_entry* e = _my_zip_seek_entry_get(zip, index);
+    if (e == NULL) return -1;
+    int64_t ret = 0;
+    if (offset < e->size && len > 0) {
+        thd_mutex_lock(&e->mutex);
+        ret = _my_zip_seek_to(e, offset);
+        if (ret == 0) ret = _my_zip_seek_read_forward(e, buf, (size_t)min(len, e->size - offset));
+        if (ret < 0 && e->zf) { // cursor is broken, reopen it next time
+            zip_fclose(e->zf);
+            e->zf = NULL;
+        }
+        thd_mutex_unlock(&e->mutex);
+    }
+    _my_zip_seek_entry_put(e);
+    return ret;
+}
+
+void my_zip_seek_release(zip_t* zip) {
+    _my_zip_seek_lock();
+    _my_zip_seek_entry** pe = &__seek_entries;
+    while (*pe) {
+        if ((*pe)->zip == zip) _my_zip_seek_entry_remove(pe);
+        else pe = &(*pe)->next;
+    }
+    thd_mutex_unlock(&__seek_mutex);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <zip.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --------------------------------------------------------------------------
+// random access read of an entry (like zran.c of zlib),
+// checkpoints (bit offset in compressed data + last 32KB of uncompressed data) are recorded
+// while inflating an entry the first time, and cached per (zip_t, entry index),
+// so a later seek inflates from the nearest checkpoint, instead of from the beginning of entry
+// --------------------------------------------------------------------------
+
+// read at most [len] bytes from [offset] of uncompressed data of entry [index],
+// return bytes count read, 0 if [offset] is at the end of entry, or < 0 if failed
+int64_t my_zip_seek_read(zip_t* zip, zip_uint64_t index, uint64_t offset, void* buf, size_t len);
+
+// free cached checkpoints of all entries of [zip], must be called before [zip] closed,
+// called by zip_close() / zip_discard() wrappers in my_zip.c
+// NOTE: at most 8 entries (64MB of checkpoints) are cached, least recently used ones are freed
+void my_zip_seek_release(zip_t* zip);
@@ -40,6 +40,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "my_message_queue.h"
 #include "my_compress.h"
 #include "my_common.h"
+#include "my_sysinfo.h"
+#include "my_store_detect.h"
+#include "my_crc32.h"
+#include "my_aes.h"
+#include "my_sha1.h"
 
 #include <zip.h>
 #include <zlib.h>
@@ -50,6 +55,17 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <limits.h>
 
 #define min(a,b) (((a) < (b)) ? (a) : (b))
+#define max(a,b) (((a) > (b)) ? (a) : (b))
+
+#define ZIP_DEFAULT_BLOCK_SIZE ((size_t)1024 * 1024 * 8)
+#define ZIP_MIN_AUTO_BLOCK_SIZE ((size_t)1024 * 256)
+#define ZIP_DEFAULT_MEMORY_USAGE ((size_t)1024 * 1024 * 128) // if available memory is unknown
+#define ZIP_MIN_AUTO_MEMORY_USAGE ((size_t)1024 * 1024 * 16)
+#define ZIP_MAX_AUTO_MEMORY_USAGE ((size_t)1024 * 1024 * 1024)
+
+// consecutive small files are pushed into 'mq_blocks' as one item, and compressed by the same thread one by one
+#define ZIP_SMALL_FILE_MAX_SIZE (1024 * 64)
+#define ZIP_SMALL_FILE_BATCH_SIZE (1024 * 1024)
 
 bool _my_zip_is_malicious_path(const char* path) {
     if (path[0] == '/' || strstr(path, "../")) return true; // malicious path, exit
@@ -59,16 +75,19 @@ bool _my_zip_is_malicious_path(const char* path) {
 struct _my_zip_callback_data;
 typedef struct _my_zip_block { // each file is divided into several blocks, and compressed by thread  
     struct _my_zip_block* nextBlock; // next block of this file
+    struct _my_zip_block* nextSmallBlock; // next small file compressed by the same thread, see ZIP_SMALL_FILE_MAX_SIZE
     _my_zip_task* task;
     struct _my_zip_callback_data* cbData;
-    size_t fileSize;
+    uint64_t fileSize;
 
     size_t blockSize;   // size of this block, default size is '_my_zip_task->defaultBlockSize'
-    size_t blockOffset; // bytes offset in the file
+    uint64_t blockOffset; // bytes offset in the file, may be larger than 4GB
     uLong crc; // crc of the original (uncompressed) data in the block
     char* compressedData; // data compressd by threads
     size_t compressedDataSize;
-    bool isCompressDone; // is this block is totally compressed into 'compressedData'
+    bool isCompressDone; // is this block is totally compressed (and encrypted if needed) into 'compressedData'
+    bool isCompressed; // compressed but may be not encrypted yet, protected by 'task->encryptMutex'
+    uint64_t encryptOffset; // offset of 'compressedData' in the encrypted data of the file
 } _my_zip_block;
 
 typedef struct _my_zip_callback_data { // userdata of zip_source callback function
@@ -76,19 +95,27 @@ typedef struct _my_zip_callback_data { // userdata of zip_source callback functi
     _my_zip_block* nowBlock; // the first block of the file that not written into zip yet
     char* filePath;
     time_t mtime; // modified time
-    size_t fileSize; // file size of current file
+    uint32_t mode; // unix permission bits, 0 if unknown (e.g. windows)
+    uint64_t fileSize; // file size of current file
     size_t bufOffset; // in 'nowBlock->compressedData', bytes written into zip
-    size_t compressedFileSize; // compressed file size
+    uint64_t compressedFileSize; // compressed file size
     uLong crc; // crc of the original (uncompressed) file content
     bool isEOF; // is all compressed data written into zip
+    char* entryPath; // entry path in zip, only used by 'task->writer'
+    bool isStored; // store without compression, because file is already compressed, e.g. .jpg, .zip
+    int storeDetectState; // ZIP_STORE_DETECT_*, magic / sample check by compress thread, protected by 'task->storeDetectMutex'
+    bool isDirectory; // only used by 'task->writer'
+    bool isEncrypted; // encrypted by compress threads with WinZip AES, only used by 'task->writer'
+    MyWinzipAes* aes; // keys of this file, derived by the thread compressing the first block
+    _my_zip_block* nextEncryptBlock; // the first block not encrypted yet, protected by 'task->encryptMutex'
+    uint64_t nextEncryptOffset; // offset of 'nextEncryptBlock' in the encrypted data
 } _my_zip_callback_data;
 
 void _my_zip_block_free(_my_zip_block* block, bool toFreeAllNextBlocks) {
     if (!block) return;
     if (block->compressedData) {
-        free(block->compressedData);
+        buffer_pool_put(&block->task->blockBufferPool, block->compressedData);
         block->compressedData = NULL;
-        atomic_int_max_sub(&block->task->allocatedBlocksTracker, 1);
     }
     if (toFreeAllNextBlocks && block->nextBlock) {
         _my_zip_block_free(block->nextBlock, true);
@@ -98,58 +125,261 @@ void _my_zip_block_free(_my_zip_block* block, bool toFreeAllNextBlocks) {
 }
 
 void _my_zip_callback_data_free(_my_zip_callback_data* data) {
+    if (!data) return;
     _my_zip_block_free(data->nowBlock, true);
+    free(data->aes);
     free(data->filePath);
+    free(data->entryPath);
     free(data);
 }
 
+// called when a block is totally written into zip, update progress and free it
+void _my_zip_block_release(_my_zip_block* block) {
+    _my_zip_task* task = block->task;
+    task->progress.processed_fileSize += block->blockSize;
+    task->progress.processed_compressSize += block->compressedDataSize;
+    if (block->cbData->isStored) task->progress.stored_fileSize += block->blockSize;
+
+    atomic_int_max_sub(&task->nowMemoryUsage, block->blockSize); // update 'nowMemoryUsage', and wake-up thread that waiting for memory usage decrease
+    //printf("--- free memory : %d\n", (int) atomic_int_max_get(&task->nowMemoryUsage));
+    _my_zip_block_free(block, false);
+}
+
+// called by thread when a block is totally compressed, wake-up zip_close() thread waiting for it
+void _my_zip_block_set_done(_my_zip_task* task, _my_zip_block* block) {
+    thd_mutex_lock(&task->blockDoneMutex);
+    block->isCompressDone = true;
+    thd_condition_signal_all(&task->blockDoneCond);
+    thd_mutex_unlock(&task->blockDoneMutex);
+}
+
+// wake-up zip_close() thread without any block done, e.g. task is cancelled by thread
+void _my_zip_block_wake_waiting(_my_zip_task* task) {
+    thd_mutex_lock(&task->blockDoneMutex);
+    thd_condition_signal_all(&task->blockDoneCond);
+    thd_mutex_unlock(&task->blockDoneMutex);
+}
+
+// wait until [block] is compressed by thread, return false if task cancelled before that
+bool _my_zip_block_wait_done(_my_zip_task* task, _my_zip_block* block) {
+    thd_mutex_lock(&task->blockDoneMutex);
+    while (!block->isCompressDone && !task->isCancelled) {
+        // NOTE: 'isCancelled' may be set by dart without any signal, so don't wait forever
+        thd_condition_timedwait(&task->blockDoneCond, &task->blockDoneMutex, 100);
+    }
+    bool isDone = block->isCompressDone;
+    thd_mutex_unlock(&task->blockDoneMutex);
+    return isDone;
+}
+
+#define ZIP_THREAD_READ_BUFFER_SIZE (1024 * 64)
+#define ZIP_DEFLATE_DICT_SIZE (1024 * 32) // deflate window size
+
+// generate random salt and derive keys of the file from password
+int _my_zip_callback_data_init_aes(_my_zip_task* task, _my_zip_callback_data* ud) {
+    ud->aes = (MyWinzipAes*)malloc(sizeof(MyWinzipAes));
+    if (ud->aes == NULL) return ZIP_ER_MEMORY;
+    if (my_winzip_aes_init(ud->aes, task->password) != 0) return ERR_NZ_INTERNAL_ERROR;
+    return 0;
+}
+
+// WinZip AES is AES-CTR, and the counter of a block depends on compressed size of all previous blocks of the file,
+// so blocks are encrypted in file order: the thread which compressed the first block not encrypted yet,
+// also encrypts all following blocks already compressed by other threads
+int _zip_thread_encrypt_blocks(_my_zip_task* task, _my_zip_block* block) {
+    _my_zip_callback_data* ud = block->cbData;
+    if (block->blockOffset == 0) {
+        // NOTE: other blocks of the file are encrypted after the first block, so no lock needed
+        int err = _my_zip_callback_data_init_aes(task, ud);
+        if (err) {
+            _my_zip_block_set_done(task, block);
+            return err;
+        }
+    }
+
+    _my_zip_block* lastBlock = NULL;
+    thd_mutex_lock(&task->encryptMutex);
+    block->isCompressed = true;
+    if (ud->nextEncryptBlock == block) {
+        uint64_t offset = ud->nextEncryptOffset;
+        for (_my_zip_block* b = block; b != NULL && b->isCompressed; b = b->nextBlock) {
+            b->encryptOffset = offset;
+            offset += b->compressedDataSize;
+            lastBlock = b;
+        }
+        ud->nextEncryptBlock = lastBlock->nextBlock;
+        ud->nextEncryptOffset = offset;
+    }
+    thd_mutex_unlock(&task->encryptMutex);
+    if (lastBlock == NULL) return 0; // encrypted later by the thread compressing the previous block
+
+    for (_my_zip_block* b = block; ; ) {
+        _my_zip_block* nextBlock = b->nextBlock; // NOTE: 'b' and 'ud' may be freed after the last block done
+        bool isLastBlock = b == lastBlock;
+        if (!task->isCancelled) my_aes_winzip_ctr(&ud->aes->key, b->encryptOffset, b->compressedData, b->compressedDataSize);
+        _my_zip_block_set_done(task, b);
+        if (isLastBlock) break;
+        b = nextBlock;
+    }
+    return 0;
+}
+
+#define ZIP_STORE_DETECT_DONE 0 // 'isStored' is decided
+#define ZIP_STORE_DETECT_PENDING 1
+#define ZIP_STORE_DETECT_RUNNING 2
+
+// with NZ_FLAG_STORE_BY_MAGIC / NZ_FLAG_STORE_BY_SAMPLE, the first 64KB of file is checked by compress thread instead of traversal thread,
+// only once by the first thread compressing any block of the file, other threads wait for it before reading 'isStored'
+int _zip_thread_store_detect(_my_zip_task* task, _my_zip_callback_data* ud, MyFileHandle fd, const char* preloaded, char* buf) {
+    thd_mutex_lock(&task->storeDetectMutex);
+    while (ud->storeDetectState == ZIP_STORE_DETECT_RUNNING) thd_condition_wait(&task->storeDetectCond, &task->storeDetectMutex);
+    bool isRunner = ud->storeDetectState == ZIP_STORE_DETECT_PENDING;
+    if (isRunner) ud->storeDetectState = ZIP_STORE_DETECT_RUNNING;
+    thd_mutex_unlock(&task->storeDetectMutex);
+    if (!isRunner) return 0;
+
+    int err = 0;
+    size_t len = (size_t) min(MY_STORE_DETECT_SAMPLE_SIZE, ud->fileSize);
+    const char* data = preloaded;
+    if (data == NULL) {
+        if (my_file_pread(fd, buf, len, 0) != 0) err = ZIP_ER_READ;
+        data = buf;
+    }
+    bool isStored = err == 0 && my_store_detect_by_data(data, len, task->flags);
+
+    thd_mutex_lock(&task->storeDetectMutex);
+    ud->isStored = isStored;
+    ud->storeDetectState = ZIP_STORE_DETECT_DONE;
+    thd_condition_signal_all(&task->storeDetectCond);
+    thd_mutex_unlock(&task->storeDetectMutex);
+    return err;
+}
+
+#define ZIP_THREAD_RING_QUEUE_DEPTH 32
+
+typedef struct _my_zip_thread_context { // owned by each compress thread, reused by all blocks
+    void* pStream;
+    char* inBuf;
+    MyFileRing* ring; // NULL if io_uring is not supported
+} _my_zip_thread_context;
+
+// the whole file fits in one block, read it at once (or use the preloaded data directly) and compress it by a single call,
+// which is much faster than streaming it through 'inBuf' with libdeflate or zstd
+// NOTE: if not preloaded, the read buffer must be already reserved in 'task->nowMemoryUsage' by caller
+int _zip_thread_compress_whole_file(_my_zip_task *task, void* pStream, MyFileHandle fd, const char* preloaded, _my_zip_block *block, size_t* pOutputLen) {
+    const MyCompressBackend* backend = task->compressBackend;
+    char* buf = NULL;
+    const char* data = preloaded;
+    if (data == NULL) {
+        buf = (char*)buffer_pool_get(&task->blockBufferPool, block->blockSize);
+        data = buf;
+    }
+
+    int err = data ? 0 : ZIP_ER_MEMORY;
+    if (err == 0 && buf && my_file_pread(fd, buf, block->blockSize, 0) != 0) err = ZIP_ER_READ;
+    if (err == 0) {
+        block->crc = my_crc32(0, data, block->blockSize);
+        size_t outputLen = backend->compress(pStream, data, block->blockSize, block->compressedData, backend->bound(block->blockSize));
+        if (outputLen == MY_COMPRESS_ERROR) err = ZIP_ER_COMPRESSED_DATA;
+        else *pOutputLen = outputLen;
+    }
+    if (buf) buffer_pool_put(&task->blockBufferPool, buf);
+    if (preloaded == NULL) atomic_int_max_sub(&task->nowMemoryUsage, block->blockSize);
+    return err;
+}
+
 /// compress file block by thread
-int _zip_thread_compress_block(_my_zip_task *task, _my_zip_block *block) {
+/// [preloaded] : whole content of the file if already read into memory, or NULL
+int _zip_thread_compress_block(_my_zip_task *task, _my_zip_thread_context *ctx, _my_zip_block *block, const char* preloaded) {
     if (task->isCancelled) return 0;
     block->crc = 0;
     block->isCompressDone = false;
 
-    FILE* fp = NULL;
-    _my_file_fopen(&fp, block->cbData->filePath, "rb");
-    if (!fp) {
-        task->isCancelled = true;
-        return ZIP_ER_READ;
+    // read by positioned read with 64-bit offset
+    // NOTE: not memory mapping, accessing a mapped page after the file is truncated by others raises SIGBUS and kills the app
+    _my_zip_callback_data* ud = block->cbData;
+    MyFileHandle fd = MY_FILE_INVALID_HANDLE;
+    if (preloaded == NULL) {
+        fd = my_file_open_read(ud->filePath);
+        if (fd == MY_FILE_INVALID_HANDLE) {
+            task->isCancelled = true;
+            return ZIP_ER_READ;
+        }
     }
 
-    void* pStream = _my_zlib_compress_init(task->compressLevel);
-    block->compressedData = (char*)malloc(compressBound((uLong)block->blockSize));
-    atomic_int_max_add(&task->allocatedBlocksTracker, 1);
+    const MyCompressBackend* backend = task->compressBackend;
+    void* pStream = ctx->pStream;
+    if (backend->reset(pStream) != 0) {
+        my_file_close(fd);
+        task->isCancelled = true;
+        return ERR_NZ_INTERNAL_ERROR;
+    }
+    block->compressedData = (char*)buffer_pool_get(&task->blockBufferPool, backend->bound(block->blockSize));
+    if (block->compressedData == NULL) {
+        my_file_close(fd);
+        task->isCancelled = true;
+        return ZIP_ER_MEMORY;
+    }
 
     MY_FLUSH_TYPE flushType = MY_FLUSH_NO;
     bool isEndOfFile = block->nextBlock == NULL;
 
-    char inBuf[1024 * 16];
+    char* inBuf = ctx->inBuf;
     size_t totalReadLen = 0;
     size_t totalOutputLen = 0;
-    int err = fseek(fp, (long) block->blockOffset, SEEK_SET);
-    while (err == 0) {
+    int err = _zip_thread_store_detect(task, ud, fd, preloaded, inBuf);
+    bool isStored = ud->isStored;
+    bool isWholeFile = err == 0 && block->blockOffset == 0 && isEndOfFile && !isStored && backend->compress;
+    if (isWholeFile && !preloaded && !atomic_int_max_try_add(&task->nowMemoryUsage, block->blockSize)) {
+        isWholeFile = false; // no memory for another copy of the file now, stream it through 'inBuf' instead of waiting
+    }
+    if (isWholeFile) { // the memory reserved above is released by it
+        err = _zip_thread_compress_whole_file(task, pStream, fd, preloaded, block, &totalOutputLen);
+    }
+    else if (err == 0 && block->blockOffset > 0 && task->compressLevel > 0 && !isStored && backend->set_dictionary && !task->isBlockIndexed) {
+        // prime the stream with the last 32KB of previous block (like pigz),
+        // so matches can cross the block boundary, and compression ratio is close to single-thread deflate
+        // NOTE: previous block ends with Z_SYNC_FLUSH, so all blocks of a file are still one deflate stream
+        size_t dictLen = (size_t) min(ZIP_DEFLATE_DICT_SIZE, block->blockOffset);
+        const char* dict = preloaded ? preloaded + block->blockOffset - dictLen : inBuf;
+        if (!preloaded && my_file_pread(fd, inBuf, dictLen, block->blockOffset - dictLen) != 0) err = ZIP_ER_READ;
+        if (err == 0 && backend->set_dictionary(pStream, dict, dictLen) != 0) err = ERR_NZ_INTERNAL_ERROR;
+    }
+    if (err == 0 && isStored && !preloaded && block->blockSize > 0) {
+        // no compression, read into 'compressedData' directly by one call
+        if (my_file_pread(fd, block->compressedData, block->blockSize, block->blockOffset) != 0) err = ZIP_ER_READ;
+        else block->crc = my_crc32(0, block->compressedData, block->blockSize);
+        totalOutputLen = block->blockSize;
+        totalReadLen = block->blockSize;
+    }
+    while (err == 0 && !isWholeFile) {
         if (task->isCancelled) break;
         
-        size_t count = min(sizeof(inBuf), block->blockSize - totalReadLen);
-        size_t readLen = fread(inBuf, 1, count, fp);
-        if (readLen < 0) {
+        size_t count = min(ZIP_THREAD_READ_BUFFER_SIZE, block->blockSize - totalReadLen);
+        char* data = inBuf;
+        size_t readLen = count;
+        if (readLen == 0) break; // empty block
+        if (preloaded) data = (char*) preloaded + block->blockOffset + totalReadLen;
+        else if (my_file_pread(fd, inBuf, count, block->blockOffset + totalReadLen) != 0) {
             err = ZIP_ER_READ;
-            break; // fread() error
-        }
-        else if (readLen == 0) {            
-            //printf("block %X size: %d, crc: %X\n", block, totalReadLen, block->crc);
-            break; // EOF for this block
+            break; // read error, or file is truncated while compressing
         }
 
         totalReadLen += readLen;
         int isEndOfBlock = totalReadLen == block->blockSize;           
         if (isEndOfBlock) flushType = isEndOfFile ? MY_FLUSH_FINISH : MY_FLUSH_BLOCK;
 
-        block->crc = crc32(block->crc, (Bytef*) inBuf, (uInt)readLen);
+        block->crc = my_crc32(block->crc, data, readLen);
+
+        if (isStored) { // no compression, just copy data
+            memcpy(block->compressedData + totalOutputLen, data, readLen);
+            totalOutputLen += readLen;
+            continue;
+        }
 
         const size_t len = INT_MAX; // we assume `block->compressedData` is big enough
-        size_t outputLen = _my_zlib_compress_next(pStream, inBuf, readLen, block->compressedData + totalOutputLen, len, flushType);
-        if (outputLen < 0) {
+        size_t outputLen = backend->next(pStream, data, readLen, block->compressedData + totalOutputLen, len, flushType);
+        if (outputLen == MY_COMPRESS_ERROR) {
             err = ZIP_ER_COMPRESSED_DATA;
             task->isCancelled = true;
             break;
@@ -158,23 +388,153 @@ int _zip_thread_compress_block(_my_zip_task *task, _my_zip_block *block) {
     }    
 
     block->compressedDataSize = totalOutputLen;
-    block->isCompressDone = true;
-    fclose(fp);
-    _my_zlib_compress_destroy(pStream);
+    my_file_close(fd);
+    if (err == 0 && ud->isEncrypted) err = _zip_thread_encrypt_blocks(task, block);
+    else _my_zip_block_set_done(task, block);
     if (err != 0) {
         task->isCancelled = true;
     }
     return err;
 }
 
-_my_zip_block* _zip_thread_get_next_block(_my_zip_task *task) {
+// read all small files linked by 'nextSmallBlock' with one batch of io_uring requests, instead of fopen() / fread() one by one
+// return a buffer from 'blockBufferPool' with content of all the files in order, or NULL if failed
+char* _zip_thread_preload_small_blocks(_my_zip_task *task, MyFileRing* ring, _my_zip_block *head) {
+    int count = 0;
+    size_t totalSize = 0;
+    for (_my_zip_block* b = head; b != NULL; b = b->nextSmallBlock) {
+        count++;
+        totalSize += b->blockSize;
+    }
+
+    char* data = (char*)buffer_pool_get(&task->blockBufferPool, totalSize);
+    const char** paths = (const char**)malloc(count * (sizeof(char*) * 2 + sizeof(size_t)));
+    if (data == NULL || paths == NULL) {
+        if (data) buffer_pool_put(&task->blockBufferPool, data);
+        free(paths);
+        return NULL;
+    }
+    char** bufs = (char**)(paths + count);
+    size_t* lens = (size_t*)(bufs + count);
+
+    int i = 0;
+    size_t offset = 0;
+    for (_my_zip_block* b = head; b != NULL; b = b->nextSmallBlock, i++) {
+        paths[i] = b->cbData->filePath;
+        bufs[i] = data + offset;
+        lens[i] = b->blockSize;
+        offset += b->blockSize;
+    }
+    int err = my_file_ring_read_files(ring, paths, bufs, lens, count);
+    free(paths);
+    if (err != 0) { // read them by fread() again, to report the error of which file
+        buffer_pool_put(&task->blockBufferPool, data);
+        return NULL;
+    }
+    return data;
+}
+
+// total size of [block] and all small files linked by 'nextSmallBlock'
+size_t _zip_block_batch_size(_my_zip_block* block) {
+    size_t size = 0;
+    for (_my_zip_block* b = block; b != NULL; b = b->nextSmallBlock) size += b->blockSize;
+    return size;
+}
+
+// move blocks from 'mq_blocks' into 'task->window' while memory is available, without waiting
+// NOTE: memory is always reserved in archive order, so the block needed by writer next never waits for memory used by later blocks
+void _zip_thread_fill_window(_my_zip_task *task) {
+    while (!task->isBlocksEnd && task->windowCount < ZIP_SCHEDULE_WINDOW_SIZE) {
+        if (task->windowPending == NULL) {
+            void* data = NULL;
+            if (!mq_try_pop(&task->mq_blocks, &data)) break; // nothing pushed by traversal yet
+            if (data == NULL) {
+                task->isBlocksEnd = true;
+                break;
+            }
+            task->windowPending = (_my_zip_block*)data;
+        }
+        if (!atomic_int_max_try_add(&task->nowMemoryUsage, _zip_block_batch_size(task->windowPending))) break;
+        task->window[task->windowCount++] = task->windowPending;
+        task->windowPending = NULL;
+    }
+}
+
+// with NZ_FLAG_ADAPTIVE_THREADS, called with 'mq_blocksMutex' locked after each block is compressed,
+// hill climbing: keep changing active thread count in the same direction while throughput goes up,
+// otherwise turn back, e.g. less threads if disk is the bottleneck or CPUs are busy by other processes
+void _zip_thread_adapt(_my_zip_task* task, size_t doneBytes) {
+    task->adaptBytes += doneBytes;
+    uint64_t now = my_sysinfo_get_tick_ms();
+    uint64_t elapsed = now - task->adaptStartTime;
+    if (elapsed < ZIP_ADAPT_INTERVAL_MS) return;
+
+    double rate = (double)task->adaptBytes / (double)elapsed;
+    if (task->adaptLastRate > 0) {
+        bool isBetter = task->adaptStep > 0
+            ? rate > task->adaptLastRate * 1.05 // more threads must be really faster
+            : rate >= task->adaptLastRate * 0.95; // less threads are fine if not obviously slower
+        if (!isBetter) task->adaptStep = -task->adaptStep;
+    }
+    int count = task->activeThreadCount + task->adaptStep;
+    if (count < 1 || count > task->threadCount) {
+        task->adaptStep = -task->adaptStep;
+        count = task->activeThreadCount + task->adaptStep;
+    }
+    if (count >= 1 && count <= task->threadCount) {
+        if (count > task->activeThreadCount) thd_condition_signal_all(&task->activeThreadCond);
+        task->activeThreadCount = count;
+    }
+    task->adaptLastRate = rate;
+    task->adaptBytes = 0;
+    task->adaptStartTime = now;
+}
+
+// [threadId] : 0 ~ (threadCount - 1), [doneBytes] : size of the block just compressed by this thread
+_my_zip_block* _zip_thread_get_next_block(_my_zip_task *task, int threadId, size_t doneBytes) {
     if (task->isCancelled) return NULL;
     thd_mutex_lock(&task->mq_blocksMutex);
 
-    _my_zip_block* block = (_my_zip_block*)mq_pop(&task->mq_blocks);
-    if (block) {
-        atomic_int_max_add(&task->nowMemoryUsage, block->blockSize);
-        //printf("+++ add memory : %d\n", (int)atomic_int_max_get(&task->nowMemoryUsage));
+    if (task->flags & NZ_FLAG_ADAPTIVE_THREADS) {
+        _zip_thread_adapt(task, doneBytes);
+        while (threadId >= task->activeThreadCount && !task->isBlocksEnd && !task->isCancelled) {
+            // NOTE: 'isCancelled' may be set by dart without any signal, so don't wait forever
+            thd_condition_timedwait(&task->activeThreadCond, &task->mq_blocksMutex, 100);
+        }
+    }
+
+    _zip_thread_fill_window(task);
+    if (task->windowCount == 0 && !task->isBlocksEnd) {
+        // nothing to compress now, wait for the next block in archive order
+        _my_zip_block* block = task->windowPending ? task->windowPending : (_my_zip_block*)mq_pop(&task->mq_blocks);
+        task->windowPending = NULL;
+        if (block == NULL) {
+            task->isBlocksEnd = true;
+            thd_condition_signal_all(&task->activeThreadCond); // idle threads exit
+        }
+        else {
+            atomic_int_max_add(&task->nowMemoryUsage, _zip_block_batch_size(block));
+            //printf("+++ add memory : %d\n", (int)atomic_int_max_get(&task->nowMemoryUsage));
+            task->window[task->windowCount++] = block;
+        }
+    }
+
+    // largest first, so a large block at the end of the archive doesn't become a long single thread tail,
+    // and the earliest one if the same size, because writer is waiting for it
+    _my_zip_block* block = NULL;
+    if (task->windowCount > 0) {
+        int index = 0;
+        size_t maxSize = _zip_block_batch_size(task->window[0]);
+        for (int i = 1; i < task->windowCount; i++) {
+            size_t size = _zip_block_batch_size(task->window[i]);
+            if (size > maxSize) {
+                maxSize = size;
+                index = i;
+            }
+        }
+        block = task->window[index];
+        task->windowCount--;
+        memmove(&task->window[index], &task->window[index + 1], (task->windowCount - index) * sizeof(_my_zip_block*));
     }
 
     thd_mutex_unlock(&task->mq_blocksMutex);
@@ -184,17 +544,49 @@ _my_zip_block* _zip_thread_get_next_block(_my_zip_task *task) {
 void _zip_thread_compress_block_proc(void* param) {
     _my_zip_task* task = (_my_zip_task*)param;
 
-    while (1) {
-        _my_zip_block* block = _zip_thread_get_next_block(task);
-        if (task->isCancelled) return;
-        if (block == NULL) return; // no more blocks, exit
-        if (task->isCancelled) return;
-        int err = _zip_thread_compress_block(task, block);
+    // deflate state and read buffer are allocated once for each thread, instead of once for each block
+    _my_zip_thread_context ctx;
+    ctx.pStream = task->compressBackend->init(task->compressLevel);
+    ctx.inBuf = (char*)malloc(ZIP_THREAD_READ_BUFFER_SIZE);
+    ctx.ring = my_file_ring_create(ZIP_THREAD_RING_QUEUE_DEPTH);
+    if (ctx.pStream == NULL || ctx.inBuf == NULL) {
+        if (!task->errCode) task->errCode = ZIP_ER_MEMORY;
+        task->isCancelled = true;
+        _my_zip_block_wake_waiting(task);
+    }
+    thd_mutex_lock(&task->mq_blocksMutex);
+    int threadId = task->nextThreadId++;
+    thd_mutex_unlock(&task->mq_blocksMutex);
+
+    size_t doneBytes = 0;
+    while (!task->isCancelled) {
+        _my_zip_block* block = _zip_thread_get_next_block(task, threadId, doneBytes);
+        if (task->isCancelled) break;
+        if (block == NULL) break; // no more blocks, exit
+        doneBytes = _zip_block_batch_size(block); // NOTE: 'block' may be freed after compressed
+
+        int err = 0;
+        char* preloaded = NULL; // content of all small files
+        if (ctx.ring && block->nextSmallBlock) preloaded = _zip_thread_preload_small_blocks(task, ctx.ring, block);
+        const char* data = preloaded;
+        while (block != NULL && err == 0) {
+            _my_zip_block* nextSmallBlock = block->nextSmallBlock; // NOTE: 'block' may be freed after compressed
+            size_t blockSize = block->blockSize;
+            err = _zip_thread_compress_block(task, &ctx, block, data);
+            if (data) data += blockSize;
+            block = nextSmallBlock;
+        }
+        if (preloaded) buffer_pool_put(&task->blockBufferPool, preloaded);
         if (err) {
             if (!task->errCode) task->errCode = err;
-            return;
+            _my_zip_block_wake_waiting(task); // 'isCancelled' is set, let zip_close() thread exit immediately
+            break;
         }
     }
+
+    if (ctx.pStream) task->compressBackend->destroy(ctx.pStream);
+    free(ctx.inBuf);
+    my_file_ring_destroy(ctx.ring);
 }
 
 zip_int64_t _my_zip_source_callback(void* userdata, void* data, zip_uint64_t len, zip_source_cmd_t cmd) {
@@ -203,10 +595,7 @@ zip_int64_t _my_zip_source_callback(void* userdata, void* data, zip_uint64_t len
     switch (cmd) {
     case ZIP_SOURCE_OPEN:
         if (ud->task->isCancelled) return -1;
-        while (ud->nowBlock->isCompressDone == false) {
-            if (ud->task->isCancelled) return -1;
-            Sleep(30); // TODO: performance...
-        }
+        if (!_my_zip_block_wait_done(ud->task, ud->nowBlock)) return -1;
         ud->task->progress.now_processing_filePath = ud->filePath;
         ud->isEOF = 0;
         ud->bufOffset = 0;
@@ -223,14 +612,7 @@ zip_int64_t _my_zip_source_callback(void* userdata, void* data, zip_uint64_t len
             if (compressedBufLeftLen == 0) {
                 _my_zip_block *oldBlock = ud->nowBlock;
                 ud->nowBlock = oldBlock->nextBlock;
-                
-                // update processing info
-                ud->task->progress.processed_fileSize += oldBlock->blockSize;
-                ud->task->progress.processed_compressSize += ud->bufOffset;
-
-                atomic_int_max_sub(&oldBlock->task->nowMemoryUsage, oldBlock->blockSize); // update 'nowMemoryUsage', and wake-up thread that waiting for memory usage decrease
-                //printf("--- free memory : %d\n", (int) atomic_int_max_get(&oldBlock->task->nowMemoryUsage));
-                _my_zip_block_free(oldBlock, false);
+                _my_zip_block_release(oldBlock);
 
                 ud->bufOffset = 0;
                 if (ud->nowBlock == NULL) {
@@ -238,10 +620,7 @@ zip_int64_t _my_zip_source_callback(void* userdata, void* data, zip_uint64_t len
                     break; // no more data
                 }
 
-                while (ud->nowBlock->isCompressDone == false) {
-                    if (ud->task->isCancelled) return -1;
-                    Sleep(30); // TODO: performance...
-                }
+                if (!_my_zip_block_wait_done(ud->task, ud->nowBlock)) return -1;
                 ud->crc = crc32_combine(ud->crc, ud->nowBlock->crc, (long) ud->nowBlock->blockSize);
                 continue;
             }
@@ -267,7 +646,7 @@ zip_int64_t _my_zip_source_callback(void* userdata, void* data, zip_uint64_t len
             st->crc = ud->crc;
             st->valid |= ZIP_STAT_COMP_SIZE | ZIP_STAT_CRC | ZIP_STAT_SIZE;
         }
-        st->comp_method = ZIP_CM_DEFLATE;
+        st->comp_method = ud->isStored ? ZIP_CM_STORE : ud->task->compressBackend->method;
         st->mtime = ud->mtime;
         st->valid |= ZIP_STAT_COMP_METHOD | ZIP_STAT_MTIME;
         return 0;
@@ -278,7 +657,7 @@ zip_int64_t _my_zip_source_callback(void* userdata, void* data, zip_uint64_t len
 
     case ZIP_SOURCE_FREE:
         ud->task->progress.now_processing_filePath = (char*)"";
-        queue_pop(&ud->task->queue_cb_data);
+        queue_remove(&ud->task->queue_cb_data, ud); // NOTE: not always the first one, e.g. zip_file_add() failed
         _my_zip_callback_data_free(ud);
         return 0;
 
@@ -298,33 +677,248 @@ zip_int64_t _my_zip_source_callback(void* userdata, void* data, zip_uint64_t len
     }
 }
 
+// --------------------------------------------------------------------------
+// write entries by 'task->writer', used when creating a new .zip file
+// compressed blocks are written into file as soon as they are ready, no need to wait for zip_close()
+// --------------------------------------------------------------------------
+
+// WinZip AES: salt and password verifier are written before the encrypted data
+int _my_zip_writer_begin_aes(MyZipWriter* writer, MyWinzipAes* aes, MyHmacSha1* hmac) {
+    my_hmac_sha1_init(hmac, aes->hmacKey, sizeof(aes->hmacKey));
+    int err = my_zip_writer_write_data(writer, aes->salt, sizeof(aes->salt));
+    if (!err) err = my_zip_writer_write_data(writer, aes->verifier, sizeof(aes->verifier));
+    return err;
+}
+
+// WinZip AES: authentication code (HMAC-SHA1 of all encrypted data) is written after the encrypted data
+int _my_zip_writer_end_aes(MyZipWriter* writer, MyHmacSha1* hmac) {
+    uint8_t mac[MY_SHA1_DIGEST_SIZE];
+    my_hmac_sha1_final(hmac, mac);
+    return my_zip_writer_write_data(writer, mac, MY_WINZIP_AES_MAC_SIZE);
+}
+
+// files smaller than this are encrypted by AE-2 (crc is not stored), because crc may leak the content
+#define ZIP_WINZIP_AE2_MAX_FILE_SIZE 20
+
+int _my_zip_writer_write_entry(_my_zip_task* task, _my_zip_callback_data* ud) {
+    MyZipWriter* writer = task->writer;
+    if (ud->isDirectory) return my_zip_writer_add_dir(writer, ud->entryPath, ud->mtime);
+
+    uint16_t aesVersion = 0;
+    size_t aesOverhead = 0;
+    MyHmacSha1 hmac;
+    if (ud->isEncrypted) {
+        aesVersion = ud->fileSize < ZIP_WINZIP_AE2_MAX_FILE_SIZE ? 2 : 1;
+        aesOverhead = MY_WINZIP_AES_OVERHEAD;
+    }
+
+    if (ud->nowBlock == NULL) { // empty file
+        int err = aesVersion ? _my_zip_callback_data_init_aes(task, ud) : 0;
+        if (!err) err = my_zip_writer_begin_file(writer, ud->entryPath, ud->mtime, ud->mode, ZIP_CM_STORE, 0, true, 0, aesOverhead, aesVersion);
+        if (!err && aesVersion) err = _my_zip_writer_begin_aes(writer, ud->aes, &hmac);
+        if (!err && aesVersion) err = _my_zip_writer_end_aes(writer, &hmac);
+        if (!err) err = my_zip_writer_end_file(writer, 0);
+        return err;
+    }
+
+    if (!_my_zip_block_wait_done(task, ud->nowBlock)) return ERR_NZ_CANCELLED;
+    task->progress.now_processing_filePath = ud->filePath;
+
+    // if only one block, crc and compressed size are known now, so local header needn't be updated later
+    _my_zip_block* firstBlock = ud->nowBlock;
+    bool isDataKnown = firstBlock->nextBlock == NULL;
+    int err = my_zip_writer_begin_file(writer, ud->entryPath, ud->mtime, ud->mode, ud->isStored ? ZIP_CM_STORE : task->compressBackend->method, ud->fileSize,
+        isDataKnown, (uint32_t)firstBlock->crc, firstBlock->compressedDataSize + aesOverhead, aesVersion);
+    if (!err && aesVersion) err = _my_zip_writer_begin_aes(writer, ud->aes, &hmac); // 'ud->aes' is ready after the first block done
+    if (!err && task->isBlockIndexed && !isDataKnown && !ud->isStored && !aesVersion) {
+        my_zip_writer_begin_block_index(writer, task->maxBlockSize); // NOTE: not an error if failed, just no index
+    }
+    ud->crc = firstBlock->crc;
+
+    while (err == 0 && ud->nowBlock != NULL) {
+        _my_zip_block* block = ud->nowBlock;
+        if (block != firstBlock) {
+            if (!_my_zip_block_wait_done(task, block)) return ERR_NZ_CANCELLED;
+            ud->crc = crc32_combine(ud->crc, block->crc, (long)block->blockSize);
+        }
+
+        if (aesVersion) my_hmac_sha1_update(&hmac, block->compressedData, block->compressedDataSize);
+        err = my_zip_writer_write_block(writer, block->compressedData, block->compressedDataSize, (uint32_t)block->crc);
+        ud->compressedFileSize += block->compressedDataSize;
+        ud->nowBlock = block->nextBlock;
+        _my_zip_block_release(block);
+    }
+
+    if (err == 0 && aesVersion) err = _my_zip_writer_end_aes(writer, &hmac);
+    if (err == 0) err = my_zip_writer_end_file(writer, (uint32_t)ud->crc);
+    return err;
+}
+
+void _zip_thread_write_entries_proc(void* param) {
+    _my_zip_task* task = (_my_zip_task*)param;
+
+    while (1) {
+        _my_zip_callback_data* ud = (_my_zip_callback_data*)mq_pop(&task->mq_entries);
+        if (ud == NULL) return; // no more entries, exit
+
+        int err = task->isCancelled ? ERR_NZ_CANCELLED : _my_zip_writer_write_entry(task, ud);
+        task->progress.now_processing_filePath = (char*)"";
+        if (err == 0) {
+            _my_zip_callback_data_free(ud);
+            continue;
+        }
+
+        // NOTE: some blocks of 'ud' may be still used by compress threads,
+        //       so free it in zipDir() after all threads finished
+        queue_push(&task->queue_cb_data, ud);
+        if (err != ERR_NZ_CANCELLED && !task->errCode) task->errCode = err;
+        task->isCancelled = true;
+        _my_zip_block_wake_waiting(task);
+    }
+}
+
+void _zipDir_push_small_blocks(_my_zip_task* task) {
+    if (task->smallBlocksHead == NULL) return;
+    mq_push(&task->mq_blocks, task->smallBlocksHead);
+    task->smallBlocksHead = task->smallBlocksTail = NULL;
+    task->smallBlocksSize = 0;
+}
+
+void _zipDir_push_blocks(_my_zip_task* task, _my_zip_block* firstBlock) {
+    if (firstBlock == NULL) return;
+    if (firstBlock->nextBlock == NULL && firstBlock->blockSize <= ZIP_SMALL_FILE_MAX_SIZE) {
+        // small file, push it later with other small files
+        if (task->smallBlocksTail) task->smallBlocksTail->nextSmallBlock = firstBlock;
+        else task->smallBlocksHead = firstBlock;
+        task->smallBlocksTail = firstBlock;
+        task->smallBlocksSize += firstBlock->blockSize;
+        if (task->smallBlocksSize + ZIP_SMALL_FILE_MAX_SIZE > task->smallBlocksBatchSize) _zipDir_push_small_blocks(task);
+        return;
+    }
+
+    // NOTE: blocks must be pushed in the same order as the entries written into zip,
+    //       or blocks of next entries may use all of 'nowMemoryUsage', and blocks of current entry wait forever
+    _zipDir_push_small_blocks(task);
+
+    // push fileA:block1, fileA:block2, fileA:block3, ..., fileB:block1, fileB:block2, ...., fileC:block1, ...
+    // and compress all the blocks by thread
+    for (_my_zip_block* block = firstBlock; block != NULL; ) {
+        _my_zip_block* nextBlock = block->nextBlock; // NOTE: don't access 'block' after pushed
+        mq_push(&task->mq_blocks, block);
+        block = nextBlock;
+    }
+}
+
+#define ZIP_SYNC_MTIME_TOLERANCE 2 // dos time in .zip is in 2 seconds
+#define ZIP_SYNC_CRC_BUFFER_SIZE (1024 * 256)
+
+// compute crc of the whole file, return false if failed to read
+bool _zipDir_file_crc(const char* filePath, uint32_t* pCrc) {
+    FILE* fp = NULL;
+    _my_file_fopen(&fp, filePath, "rb");
+    if (fp == NULL) return false;
+    char* buf = (char*)malloc(ZIP_SYNC_CRC_BUFFER_SIZE);
+    if (buf == NULL) {
+        fclose(fp);
+        return false;
+    }
+
+    uint32_t crc = 0;
+    size_t readLen;
+    while ((readLen = fread(buf, 1, ZIP_SYNC_CRC_BUFFER_SIZE, fp)) > 0) crc = my_crc32(crc, buf, readLen);
+    bool isOk = !ferror(fp);
+    fclose(fp);
+    free(buf);
+    *pCrc = crc;
+    return isOk;
+}
+
+// with NZ_FLAG_SYNC, return true if entry [index] in zip has the same size and modified time as the file,
+// so it is kept in zip without compressing again
+bool _zipDir_is_entry_unchanged(_my_zip_task* task, zip_int64_t index, const char* filePath, NATIVE_FILE_STAT* st) {
+    zip_stat_t zst;
+    if (zip_stat_index(task->zip, index, 0, &zst) != 0) return false;
+    if (!(zst.valid & ZIP_STAT_SIZE) || !(zst.valid & ZIP_STAT_MTIME)) return false;
+    if (zst.size != (zip_uint64_t)st->st_size) return false;
+
+    time_t diff = zst.mtime > st->st_mtime ? zst.mtime - st->st_mtime : st->st_mtime - zst.mtime;
+    if (diff > ZIP_SYNC_MTIME_TOLERANCE) return false;
+
+    if (task->flags & NZ_FLAG_SYNC_CRC) {
+        uint32_t crc = 0;
+        if (!(zst.valid & ZIP_STAT_CRC)) return false;
+        if (!_zipDir_file_crc(filePath, &crc) || crc != zst.crc) return false;
+    }
+    return true;
+}
+
 int _zipDir_traversal_onFileFound(const char* filePath, const char* relativePath, NATIVE_FILE_STAT* st, void* param) {
     _my_zip_task *task = (_my_zip_task*) param;
     zip_t *zip = task->zip;
     if (task->isCancelled) return ERR_NZ_CANCELLED;
 
     if (S_ISDIR(st->st_mode)) {
+        if (task->writer) {
+            if (relativePath[0] == '\0') return 0; // top level dir with [skipTopLevel]
+            if (task->entryNames && hashmap_insert(task->entryNames, relativePath, (void*)1) != NULL) return 0; // already added
+            _my_zip_callback_data* ud = (_my_zip_callback_data*)calloc(1, sizeof(_my_zip_callback_data));
+            ud->task = task;
+            ud->entryPath = strdup(relativePath);
+            ud->mtime = st->st_mtime;
+            ud->isDirectory = true;
+            mq_push(&task->mq_entries, ud);
+            return 0;
+        }
+
+        if ((task->flags & NZ_FLAG_SYNC) && zip_name_locate(zip, relativePath, 0) >= 0) return 0; // keep existing dir
         zip_int64_t index = zip_dir_add(zip, relativePath, ZIP_FL_ENC_UTF_8);
         if (index < 0) return ERR_NZ_ZIP_ENTRY_ALREADY_EXISTS;
         zip_file_set_mtime(zip, index, st->st_mtime, 0); // set last modified time
         return 0;
     }
 
-    size_t fileSize = st->st_size;
+    // NOTE: compress threads are already running during traversal,
+    //       so never replace an entry added by this task, its blocks may be compressing by threads now,
+    //       the first file mapped to the path is kept, and the others are skipped
+    zip_int64_t existIndex = task->writer ? -1 : zip_name_locate(zip, relativePath, 0);
+    bool isAdded = task->writer
+        ? task->entryNames && hashmap_insert(task->entryNames, relativePath, (void*)1) != NULL
+        : existIndex >= task->originalEntriesCount;
+    if (isAdded) {
+        notifyDartPrintf("zipDir(): '%s' is skipped, entry '%s' is already added", filePath, relativePath);
+        return 0;
+    }
+    if (existIndex >= 0 && (task->flags & NZ_FLAG_SYNC) && _zipDir_is_entry_unchanged(task, existIndex, filePath, st)) {
+        return 0; // not modified, libzip copies the compressed data of the entry as is in zip_close()
+    }
+
+    uint64_t fileSize = st->st_size;
     _my_zip_callback_data* ud = (_my_zip_callback_data*)calloc(1, sizeof(_my_zip_callback_data));
     ud->task = task;
     ud->filePath = strdup(filePath);
     ud->fileSize = fileSize;
     ud->mtime = st->st_mtime;
+#ifndef _WIN32
+    ud->mode = st->st_mode & 07777; // keep executable bits
+#endif
+    if (task->writer) {
+        // magic / sample check reads the file, so it is done by compress thread, see _zip_thread_store_detect()
+        ud->isStored = my_store_detect_by_extension(filePath, task->flags);
+        bool isDetectByData = (task->flags & (NZ_FLAG_STORE_BY_MAGIC | NZ_FLAG_STORE_BY_SAMPLE)) && fileSize >= MY_STORE_DETECT_MIN_FILE_SIZE;
+        ud->storeDetectState = !ud->isStored && isDetectByData ? ZIP_STORE_DETECT_PENDING : ZIP_STORE_DETECT_DONE;
+    }
+    else {
+        // NOTE: libzip needs the method when the entry is added, see zip_set_file_compression() below
+        ud->isStored = (task->flags & NZ_FLAG_STORE_BY_ALL) && fileSize > 0 && my_store_detect(filePath, fileSize, task->flags);
+    }
 
     // divide each file to multiple blocks
-    // push fileA:block1, fileA:block2, fileA:block3, ..., fileB:block1, fileB:block2, ...., fileC:block1, ...
-    // and compress all the blocks by thread
+    // fileA:block1 -> fileA:block2 -> fileA:block3 -> ...
     _my_zip_block* first_block = NULL;
     _my_zip_block* prev_block = NULL;
-    for (size_t offset = 0; offset < fileSize; offset += task->maxBlockSize) {
+    for (uint64_t offset = 0; offset < fileSize; offset += task->maxBlockSize) {
         _my_zip_block* block = (_my_zip_block*)calloc(1, sizeof(_my_zip_block));
-        size_t blockSize = min(task->maxBlockSize, fileSize - offset);
+        size_t blockSize = (size_t) min((uint64_t) task->maxBlockSize, fileSize - offset);
         block->task = task;
         block->cbData = ud;
         block->fileSize = fileSize;
@@ -333,14 +927,23 @@ int _zipDir_traversal_onFileFound(const char* filePath, const char* relativePath
         block->compressedData = NULL;
         block->isCompressDone = false;
         block->crc = 0;
-        mq_push(&task->mq_blocks, block);
 
         if (prev_block == NULL) first_block = block;
         else prev_block->nextBlock = block;
         prev_block = block;
     }
     ud->nowBlock = first_block;
-    task->progress.total_fileSize += fileSize;
+
+    if (task->writer) {
+        // NOTE: duplicated entry is checked by 'task->writer'
+        ud->entryPath = strdup(relativePath);
+        ud->isEncrypted = task->password != NULL;
+        ud->nextEncryptBlock = first_block;
+        _zipDir_push_blocks(task, first_block);
+        mq_push(&task->mq_entries, ud); // NOTE: don't access 'ud' after pushed
+        task->progress.total_fileSize += fileSize;
+        return 0;
+    }
 
     // 'filePath' and 'relativePath' must be utf-8 string
     zip_source_t* source = NULL;
@@ -348,25 +951,39 @@ int _zipDir_traversal_onFileFound(const char* filePath, const char* relativePath
         source = zip_source_file(zip, filePath, 0, 0);
         free(ud->filePath);
         free(ud);
+        ud = NULL;
     }
     else {
         // pass the first block of each file into callback
         source = zip_source_function(zip, _my_zip_source_callback, ud);
-        queue_push(&task->queue_cb_data, ud);
+        queue_push(&task->queue_cb_data, ud); // if 'source' is NULL, 'ud' is freed in zipDir()
     }
     if (source == NULL) {
-        //free(ud);
         return ZIP_ER_WRITE;
     }
 
     zip_int64_t index = zip_file_add(zip, relativePath, source, ZIP_FL_OVERWRITE);
     if (index < 0) {
-        //free(ud);
-        zip_source_free(source);
+        zip_source_free(source); // 'ud' and all its blocks are freed in 'ZIP_SOURCE_FREE'
         return ERR_NZ_ZIP_ENTRY_ALREADY_EXISTS;
     }
 
-    if (task->hasPassword) {
+    int method = ud && ud->isStored ? ZIP_CM_STORE : task->compressBackend->method;
+    if (method != ZIP_CM_DEFLATE) {
+        // NOTE: libzip re-compresses the data if its method is not the same as the entry's method (default is deflate),
+        //       and libzip treats data of ZIP_CM_STORE source as uncompressed data
+        if (zip_set_file_compression(zip, index, method, 0) != 0) {
+            task->errCode = my_zip_get_error(zip);
+            task->isCancelled = true;
+        }
+    }
+
+    // NOTE: push blocks after zip_file_add() success, so threads never access blocks freed by zip_source_free()
+    _zipDir_push_blocks(task, first_block);
+    task->progress.total_fileSize += fileSize;
+
+    if (task->password) {
+        // NOTE: libzip encrypts all entries in zip_close() thread, only used when adding files into an existing .zip file
         int err = zip_file_set_encryption(zip, index, ZIP_EM_AES_256, NULL); // use default5 password set into zip_set_default_password()
         if (err) {
             err = my_zip_get_error(zip);
@@ -382,16 +999,37 @@ int _zipDir_traversal_onFileFound(const char* filePath, const char* relativePath
 }
 
 
+// if 'task->maxMemoryUsage' or 'task->maxBlockSize' is 0, decide it by available memory and [threadCount]
+void _zipDir_auto_memory_config(_my_zip_task* task, int threadCount) {
+    if (task->maxMemoryUsage == 0) {
+        size_t availableMemory = my_sysinfo_get_available_memory();
+        size_t size = availableMemory ? availableMemory / 8 : ZIP_DEFAULT_MEMORY_USAGE;
+        task->maxMemoryUsage = min(max(size, ZIP_MIN_AUTO_MEMORY_USAGE), ZIP_MAX_AUTO_MEMORY_USAGE);
+    }
+    if (task->maxBlockSize == 0) {
+        // each thread can compress one block while another block is waiting to write
+        size_t size = task->maxMemoryUsage / ((size_t)threadCount * 2);
+        task->maxBlockSize = min(max(size, ZIP_MIN_AUTO_BLOCK_SIZE), ZIP_DEFAULT_BLOCK_SIZE);
+        task->maxBlockSize = min(task->maxBlockSize, task->maxMemoryUsage);
+    }
+}
+
 // NOTE: zipDir()will call zip_close() in the end
-int zipDir(_my_zip_task *task, void *_zip, const char** dirPathList, int dirPathListCount, const char *entryDirPathBase, bool skipTopLevel, int threadCount) {
+// [zipFilePath] is the path of [_zip], can be NULL.
+// if not NULL and [_zip] has no entries, the .zip file is written by 'MyZipWriter' instead of libzip
+int zipDir(_my_zip_task *task, void *_zip, const char* zipFilePath, const char** dirPathList, int dirPathListCount, const char *entryDirPathBase, bool skipTopLevel, int threadCount) {
     // [entryDirPathBase] must be "", or ends with '/', and cannot starts with '/', it must be a directory path
 
     zip_t* zip = (zip_t*)_zip;
-    const int maxBlockSize = 1024 * 1024 * 8;
-    const size_t maxMemoryUsage = 1024 * 1024 * 128;
 
     if (dirPathListCount < 1) return ERR_NZ_INVALID_ARGUMENT;
-    if (threadCount < 1) return ERR_NZ_INVALID_ARGUMENT;
+    if (threadCount < 1) threadCount = my_sysinfo_get_cpu_count(); // auto
+    task->compressBackend = my_compress_get_backend(task->compressMethod ? task->compressMethod : ZIP_CM_DEFLATE);
+    if (task->compressBackend == NULL) return ZIP_ER_COMPNOTSUPP; // e.g. zstd, but not built with NATIVE_ZIP_ZSTD
+    _zipDir_auto_memory_config(task, threadCount);
+    const size_t maxBlockSize = task->maxBlockSize;
+    const size_t maxMemoryUsage = task->maxMemoryUsage;
+    if (maxBlockSize > maxMemoryUsage) return ERR_NZ_INVALID_ARGUMENT; // a block must fit in memory budget, or thread waits forever
     if (_my_zip_is_malicious_path(entryDirPathBase)) return ERR_NZ_INVALID_PATH; // malicious path, exit
     if (entryDirPathBase[0] != '\0' && (entryDirPathBase[0] == '/' || entryDirPathBase[strlen(entryDirPathBase) - 1] != '/')) {
         // [entryDirPathBase] must be "", or ends with '/', and cannot starts with '/'
@@ -399,58 +1037,144 @@ int zipDir(_my_zip_task *task, void *_zip, const char** dirPathList, int dirPath
     }
 
 
+    for (int i = 0; i < dirPathListCount; i++) {
+        const char* path = dirPathList[i];
+        if (*path == '\0' || path[strlen(path) - 1] == DIR_SEPARATOR) return ERR_NZ_INVALID_PATH;
+        _my_file_path_separator_fix((char*)path);
+    }
+
+
     // NOTE: we divide each file to blocks (max size is 'maxBlockSize'), and compress these blocks in threads, then write into zip file
+    //       threads are started before directory traversal, so blocks are compressed while traversal is still running
 
     int err = 0;
     //memset(task, 0, sizeof(_my_zip_task));
     task->zip = zip;
     task->isCancelled = false;
-    task->maxBlockSize = maxBlockSize;
+    task->originalEntriesCount = zip_get_num_entries(zip, 0);
     task->entryDirPathBase = entryDirPathBase;
     task->progress.now_processing_filePath = (char*)"";
     mq_init(&task->mq_blocks);
+    task->windowCount = 0;
+    task->windowPending = NULL;
+    task->isBlocksEnd = false;
+    task->threadCount = threadCount;
+    task->nextThreadId = 0;
+    task->activeThreadCount = threadCount;
+    task->adaptStartTime = my_sysinfo_get_tick_ms();
+    task->adaptBytes = 0;
+    task->adaptLastRate = 0;
+    task->adaptStep = -1; // try less threads first
+    thd_condition_init(&task->activeThreadCond);
     queue_create(&task->queue_cb_data);
-
-    for (int i = 0; i < dirPathListCount; i++) {
-        const char* path = dirPathList[i];
-        if (*path == '\0' || path[strlen(path) - 1] == DIR_SEPARATOR) return ERR_NZ_INVALID_PATH;
-        _my_file_path_separator_fix((char*)path);
-
-        err = my_dir_traversal(path, entryDirPathBase, skipTopLevel, _zipDir_traversal_onFileFound, task);
-        if (err != 0 || task->isCancelled) {
-            // cleanup
-            mq_destroy(&task->mq_blocks, free);
-            queue_destroy(&task->queue_cb_data, (void (*)(void*))_my_zip_callback_data_free);
-            return err;
+    thd_mutex_init(&task->mq_blocksMutex);
+    thd_mutex_init(&task->blockDoneMutex);
+    thd_mutex_init(&task->encryptMutex);
+    thd_mutex_init(&task->storeDetectMutex);
+    thd_condition_init(&task->storeDetectCond);
+    thd_condition_init(&task->blockDoneCond);
+    atomic_int_max_init(&task->nowMemoryUsage, 0, maxMemoryUsage);
+    buffer_pool_init(&task->blockBufferPool, maxMemoryUsage); // at most 'maxMemoryUsage' blocks are compressing, so keep the same size of free buffers
+
+    // when creating a new .zip file, write it by 'MyZipWriter' into a temp file,
+    // each entry is written as soon as its blocks are compressed (and encrypted by threads if password is set), instead of all in zip_close()
+    MyZipWriter writer;
+    thd_thread writerThread;
+    char* tmpFilePath = NULL;
+    task->writer = NULL;
+    task->entryNames = NULL;
+    task->smallBlocksHead = task->smallBlocksTail = NULL;
+    task->smallBlocksSize = 0;
+    task->smallBlocksBatchSize = min(ZIP_SMALL_FILE_BATCH_SIZE, maxMemoryUsage);
+    mq_init(&task->mq_entries);
+    if (zipFilePath != NULL && task->originalEntriesCount == 0) {
+        size_t len = strlen(zipFilePath) + 8;
+        tmpFilePath = (char*)malloc(len);
+        snprintf(tmpFilePath, len, "%s.nztmp", zipFilePath);
+        if (my_zip_writer_open(&writer, tmpFilePath) == 0
+            && thd_thread_create(&writerThread, _zip_thread_write_entries_proc, task) == 0) {
+            task->writer = &writer;
+            task->entryNames = hashmap_create(1024);
+        }
+        else { // use libzip instead
+            my_zip_writer_destroy(&writer);
+            my_file_remove(tmpFilePath);
+            FREEIF(tmpFilePath);
         }
     }
-    for (int i = 0; i <= threadCount; i++) mq_push(&task->mq_blocks, NULL); // notify threads that no more blocks
+
+    // blocks of deflate entries are compressed without dictionary only if the index is recorded by 'writer'
+    task->isBlockIndexed = (task->flags & NZ_FLAG_BLOCK_INDEX) && task->writer && !task->password
+        && task->compressBackend->method == ZIP_CM_DEFLATE;
 
     //_zip_thread_compress_block
     SimpleThreadPool pool;
-    thd_mutex_init(&task->mq_blocksMutex);
-    atomic_int_max_init(&task->nowMemoryUsage, 0, maxMemoryUsage);
-    atomic_int_max_init(&task->allocatedBlocksTracker, 0, maxMemoryUsage);
-    simple_thread_pool_create(&pool, threadCount, _zip_thread_compress_block_proc, task);
-    
-    // libzip write all changes into .zip file
-    err = zip_close(zip); // NOTE: don't use my_zip_close() here, and don't call zip_discard() immediately
-    task->isZipClosed = true;
-    if (err) task->isCancelled = true;
-    //printf("zip error: %s", zip_error_strerror(zip_get_error(zip)));
-
-    atomic_int_max_invalid(&task->nowMemoryUsage); // wake-up all threads if thread is waiting for 'nowMemoryUsage' value down
-    simple_thread_pool_destroy(&pool); // wait for all thread finish
-    
-    if (err) {
-        // NOTE:
-        //   if zip_close() failed, call zip_discard() after all thread finished,
-        //   because zip_discard() cause all zip_source freed, 
-        //   which may cause 'case ZIP_SOURCE_FREE:' in '_my_zip_source_callback' called, 
-        //   which will free all '_my_zip_block', and app crash if thread access them
-        err = my_zip_get_error(zip);
+    if (simple_thread_pool_create(&pool, threadCount, _zip_thread_compress_block_proc, task) != 0) {
+        err = ERR_NZ_INTERNAL_ERROR;
+    }
+
+    for (int i = 0; i < dirPathListCount && err == 0; i++) {
+        err = my_dir_traversal(dirPathList[i], entryDirPathBase, skipTopLevel, _zipDir_traversal_onFileFound, task);
+        if (task->isCancelled) break;
+    }
+    if (err == 0) _zipDir_push_small_blocks(task);
+    for (int i = 0; i <= threadCount; i++) mq_push(&task->mq_blocks, NULL); // notify threads that no more blocks
 
+    if (task->writer) {
+        if (err != 0) task->isCancelled = true;
+        mq_push(&task->mq_entries, NULL); // notify writer thread that no more entries
+        thd_thread_join(&writerThread);
+        if (err == 0 && !task->isCancelled) {
+            err = my_zip_writer_close(&writer);
+            if (err) task->isCancelled = true;
+        }
+        else if (err == 0 || err == ERR_NZ_CANCELLED) {
+            err = task->errCode ? task->errCode : ERR_NZ_CANCELLED;
+        }
+
+        atomic_int_max_invalid(&task->nowMemoryUsage); // wake-up all threads if thread is waiting for 'nowMemoryUsage' value down
+        simple_thread_pool_destroy(&pool); // wait for all thread finish
+        my_zip_writer_destroy(&writer);
+
+        // NOTE: zip_discard() before rename, because [_zip] may still open the original .zip file
         zip_discard(zip);
+        task->isZipClosed = true;
+        if (err == 0 && my_file_rename(tmpFilePath, zipFilePath) != 0) err = ZIP_ER_RENAME;
+        if (err != 0) my_file_remove(tmpFilePath);
+        free(tmpFilePath);
+    }
+    else if (err != 0 || task->isCancelled) {
+        // traversal failed or cancelled, stop all threads, and discard all changes
+        task->isCancelled = true;
+        atomic_int_max_invalid(&task->nowMemoryUsage); // wake-up all threads if thread is waiting for 'nowMemoryUsage' value down
+        simple_thread_pool_destroy(&pool); // wait for all thread finish
+
+        // NOTE: zip_discard() must be called after all thread finished,
+        //       it frees all '_my_zip_callback_data' and '_my_zip_block' by 'ZIP_SOURCE_FREE'
+        zip_discard(zip);
+        task->isZipClosed = true;
+        if (err == 0) err = task->errCode ? task->errCode : ERR_NZ_CANCELLED;
+    }
+    else {
+        // libzip write all changes into .zip file
+        err = zip_close(zip); // NOTE: don't use my_zip_close() here, and don't call zip_discard() immediately
+        task->isZipClosed = true;
+        if (err) task->isCancelled = true;
+        //printf("zip error: %s", zip_error_strerror(zip_get_error(zip)));
+
+        atomic_int_max_invalid(&task->nowMemoryUsage); // wake-up all threads if thread is waiting for 'nowMemoryUsage' value down
+        simple_thread_pool_destroy(&pool); // wait for all thread finish
+
+        if (err) {
+            // NOTE:
+            //   if zip_close() failed, call zip_discard() after all thread finished,
+            //   because zip_discard() cause all zip_source freed, 
+            //   which may cause 'case ZIP_SOURCE_FREE:' in '_my_zip_source_callback' called, 
+            //   which will free all '_my_zip_block', and app crash if thread access them
+            err = my_zip_get_error(zip);
+
+            zip_discard(zip);
+        }
     }
 
     // NOTE: if user cancelled or error occurs during saving zip file, that is to say, during zip_close(),
@@ -459,16 +1183,28 @@ int zipDir(_my_zip_task *task, void *_zip, const char** dirPathList, int dirPath
     queue_destroy(&task->queue_cb_data, (void (*)(void*))_my_zip_callback_data_free);
 
     mq_destroy(&task->mq_blocks, NULL); // all blocks already freed by _my_zip_callback_data_free above
+    mq_destroy(&task->mq_entries, NULL); // writer thread pop all entries before exit
+    task->writer = NULL;
+    if (task->entryNames) {
+        hashmap_free(task->entryNames, NULL);
+        task->entryNames = NULL;
+    }
     thd_mutex_destroy(&task->mq_blocksMutex);
+    thd_mutex_destroy(&task->blockDoneMutex);
+    thd_mutex_destroy(&task->encryptMutex);
+    thd_mutex_destroy(&task->storeDetectMutex);
+    thd_condition_destroy(&task->storeDetectCond);
+    thd_condition_destroy(&task->blockDoneCond);
+    thd_condition_destroy(&task->activeThreadCond);
     
     if (atomic_int_max_get(&task->nowMemoryUsage) != 0
-        || atomic_int_max_get(&task->allocatedBlocksTracker) != 0) {
+        || buffer_pool_used_count(&task->blockBufferPool) != 0) {
         printf("################# zipDir() memory leak detected #################\n");
         notifyDartLog("################# zipDir() memory leak detected  #################");
     }
 
     atomic_int_max_destroy(&task->nowMemoryUsage);
-    atomic_int_max_destroy(&task->allocatedBlocksTracker);
+    buffer_pool_destroy(&task->blockBufferPool);
 
     return err;
 }
@@ -478,17 +1214,595 @@ int zipDir(_my_zip_task *task, void *_zip, const char** dirPathList, int dirPath
 // unzipDir
 // --------------------------------------------------------------------------
 
+typedef struct _my_unzip_block_job { // a big entry with block index, inflated by all threads block by block
+    _my_unzip_task* task;
+    char* filePath;
+    MyFileHandle fd;
+    MyZipBlockIndex blockIndex;
+    uint64_t size;
+    time_t mtime; // 0 if not exists
+    uint32_t blocksLeft; // blocks not finished yet, the last one closes the file and frees the job
+    uint64_t preallocated; // disk space reserved, 0 if not
+    uint64_t validSize; // offset of the first block failed or not inflated, or [size] if all done
+    thd_mutex mutex;
+} _my_unzip_block_job;
+
 typedef struct _my_unzip_file_info {
     zip_int64_t index;
     size_t basePathLen;
+    uint64_t size; // uncompressed size, bigger entries are pushed into queue first
+    struct _my_unzip_file_info* next; // small entries are popped together as a batch
+    _my_unzip_block_job* job; // if not NULL, this is the block [blockIndex] of [job]
+    uint32_t blockIndex;
+    uint64_t blockDataOffset;
 } _my_unzip_file_info;
 
-int _unzipToDir_unzipEntry(_my_unzip_task* task, zip_t* zip, _my_unzip_file_info* info) {
+// deflate / stored entry without encryption, can be read by ZIP_FL_COMPRESSED and decompressed by ourselves
+bool _unzipToDir_can_read_raw(const struct zip_stat* st) {
+    const zip_uint64_t valid = ZIP_STAT_SIZE | ZIP_STAT_COMP_SIZE | ZIP_STAT_CRC | ZIP_STAT_COMP_METHOD | ZIP_STAT_ENCRYPTION_METHOD;
+    if ((st->valid & valid) != valid) return false;
+    if (st->encryption_method != ZIP_EM_NONE) return false;
+    return st->comp_method == ZIP_CM_DEFLATE || st->comp_method == ZIP_CM_STORE;
+}
+
+#define UNZIP_INPUT_BUFFER_SIZE (1024 * 256)
+#define UNZIP_OUTPUT_BUFFER_SIZE (1024 * 1024) // each write() syscall is at least 1MB, except the end of file
+#define UNZIP_RING_QUEUE_DEPTH 4
+#define UNZIP_PREALLOCATE_MIN_SIZE (1024 * 1024) // reserve disk space of big files before writing, to reduce fragmentation
+#define UNZIP_PREALLOCATE_MAX_RATIO 32 // sizes in central directory are not trusted, reserve at most 32x of compressed size
+#define UNZIP_NO_CACHE_MIN_SIZE ((uint64_t)1024 * 1024 * 8) // with NZ_FLAG_NO_CACHE, written data of big files are dropped from page cache every 8MB
+
+typedef struct _my_unzip_thread_context { // owned by each unzip thread, reused by all entries
+    zip_t* zip; // for entries cannot be read by 'task->reader', opened when first used if 'isZipOwned'
+    bool isZipOwned;
+    MyFileRing* ring; // NULL if io_uring is not supported
+    char* inBuf; // NULL if out of memory, also the start of all buffers below, registered into 'ring' if possible
+    char* inBufs[2]; // compressed data is inflated from one buffer, while the next part is read into the other one by 'ring' (the same buffer if no 'ring')
+    char* outBufs[2]; // data is inflated into one buffer, while the other one is written by 'ring' (the same buffer if no 'ring')
+} _my_unzip_thread_context;
+
+// [zip] : libzip handle of this thread, or NULL to open it when needed
+void _unzipToDir_thread_context_init(_my_unzip_thread_context* ctx, zip_t* zip) {
+    ctx->zip = zip;
+    ctx->isZipOwned = zip == NULL;
+    ctx->ring = my_file_ring_create(UNZIP_RING_QUEUE_DEPTH);
+    size_t size = (UNZIP_INPUT_BUFFER_SIZE + UNZIP_OUTPUT_BUFFER_SIZE) * (ctx->ring ? 2 : 1);
+    ctx->inBuf = (char*)malloc(size);
+    if (ctx->inBuf == NULL && ctx->ring) { // use pread() / fwrite() instead
+        my_file_ring_destroy(ctx->ring);
+        ctx->ring = NULL;
+        size = UNZIP_INPUT_BUFFER_SIZE + UNZIP_OUTPUT_BUFFER_SIZE;
+        ctx->inBuf = (char*)malloc(size);
+    }
+    int n = ctx->ring ? 2 : 1;
+    for (int i = 0; i < 2; i++) {
+        ctx->inBufs[i] = ctx->inBuf ? ctx->inBuf + UNZIP_INPUT_BUFFER_SIZE * (i % n) : NULL;
+        ctx->outBufs[i] = ctx->inBuf ? ctx->inBuf + UNZIP_INPUT_BUFFER_SIZE * n + UNZIP_OUTPUT_BUFFER_SIZE * (i % n) : NULL;
+    }
+    // NOTE: not an error if failed, e.g. RLIMIT_MEMLOCK exceeded, pages are just mapped by kernel for each request
+    if (ctx->ring && ctx->inBuf) my_file_ring_register_buffer(ctx->ring, ctx->inBuf, size);
+}
+
+void _unzipToDir_thread_context_destroy(_my_unzip_thread_context* ctx) {
+    if (ctx->isZipOwned && ctx->zip) my_zip_close(ctx->zip);
+    my_file_ring_destroy(ctx->ring);
+    free(ctx->inBuf);
+}
+
+// libzip handle of this thread, NULL if failed to open
+// NOTE: most entries are read by 'task->reader', so threads don't parse central directory again in zip_open() unless needed
+zip_t* _unzipToDir_thread_zip(_my_unzip_task* task, _my_unzip_thread_context* ctx) {
+    if (ctx->zip || !ctx->isZipOwned) return ctx->zip;
+    int err;
+    zip_t* zip = zip_open(task->zipFilePath, ZIP_RDONLY, &err);
+    if (!zip) return NULL;
+    if (task->password && zip_set_default_password(zip, task->password) != 0) {
+        my_zip_close(zip);
+        return NULL;
+    }
+    ctx->zip = zip;
+    return zip;
+}
+
+// fill [st] of entry [index] by 'task->reader', return false if the entry should be read by libzip,
+// e.g. encrypted, compressed by other methods, or name is not utf-8 (libzip converts it from CP437, or uses the Info-ZIP unicode path),
+// so the name is always the same as the one got by libzip in _unzipDir_find_files(), which 'basePathLen' is based on
+bool _unzipToDir_reader_stat(_my_unzip_task* task, zip_int64_t index, struct zip_stat* st) {
+    const MyZipReader* reader = task->reader;
+    if (reader == NULL || index < 0 || (zip_uint64_t)index >= reader->entriesCount) return false;
+    const MyZipReaderEntry* entry = &reader->entries[index];
+    const char* name = my_zip_reader_name(reader, index);
+    if (entry->hasUnicodePath) return false;
+    if (!(entry->flags & MY_ZIP_FLAG_UTF8)) {
+        for (const char* p = name; *p; p++) {
+            if ((unsigned char)*p >= 0x80) return false;
+        }
+    }
+    if (name[0] == '\0') return false;
+
+    zip_stat_init(st);
+    st->valid = ZIP_STAT_NAME | ZIP_STAT_INDEX | ZIP_STAT_SIZE | ZIP_STAT_COMP_SIZE | ZIP_STAT_MTIME
+        | ZIP_STAT_CRC | ZIP_STAT_COMP_METHOD | ZIP_STAT_ENCRYPTION_METHOD;
+    st->name = name;
+    st->index = (zip_uint64_t)index;
+    st->size = entry->uncompressedSize;
+    st->comp_size = entry->compressedSize;
+    st->mtime = my_zip_reader_mtime(entry);
+    st->crc = entry->crc;
+    st->comp_method = (zip_uint16_t)entry->method;
+    st->encryption_method = (entry->flags & MY_ZIP_FLAG_ENCRYPTED) ? ZIP_EM_UNKNOWN : ZIP_EM_NONE;
+    return name[strlen(name) - 1] == ZIP_PATH_SEPARATOR || _unzipToDir_can_read_raw(st);
+}
+
+typedef struct _my_unzip_raw_source { // raw (compressed) data of an entry
+    zip_file_t* zf; // if NULL, read from 'reader' at 'offset'
+    const MyZipReader* reader;
+    uint64_t offset;
+} _my_unzip_raw_source;
+
+typedef struct _my_unzip_input { // compressed data of an entry (or a block), read by parts of UNZIP_INPUT_BUFFER_SIZE
+    _my_unzip_raw_source* src;
+    MyFileRing* ring; // if not NULL, the next part is read ahead by 'ring' while the current one is inflating
+    char* bufs[2];
+    int now; // index of 'bufs' returned by the last _unzipToDir_input_next()
+    uint64_t left; // bytes not read yet
+    MyFileIoRequest req; // reading the next part into the other buffer by 'ring'
+    size_t aheadLen; // bytes read by 'req', 0 if not reading ahead
+} _my_unzip_input;
+
+void _unzipToDir_input_init(_my_unzip_input* in, _my_unzip_thread_context* ctx, _my_unzip_raw_source* src, uint64_t len) {
+    memset(in, 0, sizeof(_my_unzip_input));
+    in->src = src;
+    in->ring = src->zf ? NULL : ctx->ring;
+    in->bufs[0] = ctx->inBufs[0];
+    in->bufs[1] = ctx->inBufs[1];
+    in->left = len;
+}
+
+// return the next part of data, NULL if failed
+// NOTE: the returned buffer can be used until next call
+char* _unzipToDir_input_next(_my_unzip_input* in, size_t* pLen) {
+    char* buf;
+    size_t len;
+    if (in->aheadLen > 0) {
+        in->now = !in->now;
+        buf = in->bufs[in->now];
+        len = in->aheadLen;
+        in->aheadLen = 0;
+        if (my_file_ring_wait_request(in->ring, &in->req) != 0) return NULL;
+    }
+    else {
+        buf = in->bufs[in->now];
+        len = (size_t)min(UNZIP_INPUT_BUFFER_SIZE, in->left);
+        if (in->src->zf) {
+            zip_int64_t n = zip_fread(in->src->zf, buf, len);
+            if (n <= 0) return NULL;
+            len = (size_t)n;
+        }
+        else if (my_file_pread(in->src->reader->fd, buf, len, in->src->offset) != 0) return NULL;
+        in->src->offset += len;
+        in->left -= len;
+    }
+
+    if (in->ring && in->left > 0) {
+        size_t aheadLen = (size_t)min(UNZIP_INPUT_BUFFER_SIZE, in->left);
+        MyFileIoRequest req = { (int)(intptr_t)in->src->reader->fd, false, in->bufs[!in->now], aheadLen, (int64_t)in->src->offset }; // 'ring' is linux only, fd is int
+        in->req = req;
+        if (my_file_ring_submit(in->ring, &in->req, 1) == 0) { // if failed, read by pread() next time
+            in->aheadLen = aheadLen;
+            in->src->offset += aheadLen;
+            in->left -= aheadLen;
+        }
+    }
+    *pLen = len;
+    return buf;
+}
+
+// wait until the buffer read ahead is not used by 'ring', buffers are reused by next entry
+void _unzipToDir_input_close(_my_unzip_input* in) {
+    if (in->aheadLen > 0) my_file_ring_wait_request(in->ring, &in->req);
+    in->aheadLen = 0;
+}
+
+typedef struct _my_unzip_output { // output file of an entry
+    FILE* fout; // not buffered by stdio, data is written from 'buf' directly
+    MyFileRing* ring; // if not NULL, write by 'ring' in background instead of fwrite()
+    char* bufs[2];
+    char* buf; // data not written yet
+    size_t bufSize;
+    size_t len; // bytes in 'buf'
+    int64_t offset; // file offset of 'buf'
+    MyFileIoRequest req; // writing the other buffer by 'ring'
+    bool isNoCache; // drop written data from page cache, see NZ_FLAG_NO_CACHE
+    int64_t droppedOffset; // data before it is dropped from page cache
+} _my_unzip_output;
+
+void _unzipToDir_output_init(_my_unzip_output* out, _my_unzip_thread_context* ctx, FILE* fout, bool isNoCache) {
+    memset(out, 0, sizeof(_my_unzip_output));
+    out->fout = fout;
+    out->ring = ctx->ring;
+    out->bufs[0] = ctx->outBufs[0];
+    out->bufs[1] = ctx->outBufs[1];
+    out->buf = out->bufs[0];
+    out->bufSize = UNZIP_OUTPUT_BUFFER_SIZE;
+    out->isNoCache = isNoCache;
+}
+
+// [writtenOffset] : all data before it are written
+void _unzipToDir_output_drop_cache(_my_unzip_output* out, int64_t writtenOffset, bool isEnd) {
+    if (!out->isNoCache) return;
+    if (writtenOffset - out->droppedOffset < (int64_t)UNZIP_NO_CACHE_MIN_SIZE && !isEnd) return;
+    my_file_drop_cache(my_file_get_handle(out->fout), out->droppedOffset, writtenOffset - out->droppedOffset);
+    out->droppedOffset = writtenOffset;
+}
+
+int _unzipToDir_output_flush(_my_unzip_output* out) {
+    if (out->len == 0) return 0;
+    if (out->ring == NULL) {
+        size_t len = out->len;
+        out->len = 0;
+        if (fwrite(out->buf, 1, len, out->fout) != len) return ZIP_ER_WRITE;
+        out->offset += len;
+        _unzipToDir_output_drop_cache(out, out->offset, false);
+        return 0;
+    }
+
+    // wait until the other buffer written, then write this buffer in background, and fill the other one
+    if (my_file_ring_wait(out->ring) != 0) return ZIP_ER_WRITE;
+    _unzipToDir_output_drop_cache(out, out->offset, false);
+    MyFileIoRequest req = { fileno(out->fout), true, out->buf, out->len, out->offset };
+    out->req = req;
+    if (my_file_ring_submit(out->ring, &out->req, 1) != 0) return ZIP_ER_WRITE;
+    out->offset += out->len;
+    out->len = 0;
+    out->buf = out->buf == out->bufs[0] ? out->bufs[1] : out->bufs[0];
+    return 0;
+}
+
+// write all data in buffer, and wait until written
+int _unzipToDir_output_close(_my_unzip_output* out, int err) {
+    if (err == 0) err = _unzipToDir_output_flush(out);
+    if (out->ring && my_file_ring_wait(out->ring) != 0 && err == 0) err = ZIP_ER_WRITE; // NOTE: always wait, buffers are reused by next entry
+    if (err == 0) _unzipToDir_output_drop_cache(out, out->offset, true);
+    return err;
+}
+
+int _unzipToDir_output_write(_my_unzip_output* out, const char* data, size_t len) {
+    while (len > 0) {
+        if (out->len == out->bufSize && _unzipToDir_output_flush(out) != 0) return ZIP_ER_WRITE;
+        size_t count = min(len, out->bufSize - out->len);
+        memcpy(out->buf + out->len, data, count);
+        out->len += count;
+        data += count;
+        len -= count;
+    }
+    return 0;
+}
+
+// inflate raw data of entry, and check crc by my_crc32() instead of libzip
+int _unzipToDir_write_raw_entry(_my_unzip_task* task, _my_unzip_thread_context* ctx, _my_unzip_raw_source* src, const struct zip_stat* st, _my_unzip_output* out) {
+    _my_unzip_input in;
+    _unzipToDir_input_init(&in, ctx, src, st->comp_size);
+    bool isDeflate = st->comp_method == ZIP_CM_DEFLATE;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (isDeflate && inflateInit2(&stream, -MAX_WBITS) != Z_OK) return ZIP_ER_MEMORY;
+
+    int err = 0;
+    int ret = Z_OK;
+    uint32_t crc = 0;
+    zip_uint64_t totalInLen = 0;
+    zip_uint64_t totalOutLen = 0;
+    while (err == 0 && totalInLen < st->comp_size) {
+        if (task->isCancelled) break;
+        size_t len = 0;
+        char* inBuf = _unzipToDir_input_next(&in, &len);
+        if (inBuf == NULL) {
+            err = ZIP_ER_READ;
+            break;
+        }
+        totalInLen += len;
+
+        if (!isDeflate) { // stored
+            crc = my_crc32(crc, inBuf, len);
+            err = _unzipToDir_output_write(out, inBuf, len);
+            totalOutLen += len;
+            continue;
+        }
+
+        stream.next_in = (Bytef*) inBuf;
+        stream.avail_in = (uInt) len;
+        while (ret != Z_STREAM_END) {
+            if (out->len == out->bufSize && (err = _unzipToDir_output_flush(out)) != 0) break;
+            size_t space = out->bufSize - out->len;
+            stream.next_out = (Bytef*) out->buf + out->len; // inflate into output buffer directly
+            stream.avail_out = (uInt) space;
+            ret = inflate(&stream, Z_NO_FLUSH);
+            if (ret == Z_BUF_ERROR) break; // need more input
+            if (ret != Z_OK && ret != Z_STREAM_END) {
+                err = ZIP_ER_COMPRESSED_DATA;
+                break;
+            }
+            size_t outLen = space - stream.avail_out;
+            crc = my_crc32(crc, out->buf + out->len, outLen);
+            out->len += outLen;
+            totalOutLen += outLen;
+            if (stream.avail_in == 0 && stream.avail_out > 0) break; // all input consumed
+        }
+    }
+
+    if (isDeflate) inflateEnd(&stream);
+    _unzipToDir_input_close(&in);
+    if (err == 0 && !task->isCancelled) {
+        if (isDeflate && ret != Z_STREAM_END) err = ZIP_ER_COMPRESSED_DATA;
+        else if (totalOutLen != st->size) err = ZIP_ER_INCONS;
+        else if (crc != st->crc) err = ZIP_ER_CRC;
+    }
+    return err;
+}
+
+// read data decompressed by libzip, e.g. encrypted entries
+int _unzipToDir_write_entry(_my_unzip_task* task, zip_file_t* zf, const struct zip_stat* st, _my_unzip_output* out) {
+    zip_uint64_t sum = 0;
+    while (sum < st->size) {
+        if (task->isCancelled) break;
+        if (out->len == out->bufSize && _unzipToDir_output_flush(out) != 0) return ZIP_ER_WRITE;
+        zip_int64_t len = zip_fread(zf, out->buf + out->len, out->bufSize - out->len); // read into output buffer directly
+        if (len <= 0) return ZIP_ER_READ;
+        out->len += len;
+        sum += len;
+    }
+    return 0;
+}
+
+// NOTE: zip file format allow a file entry path like "a/b/c.txt"
+//       without directory entry "a" and "a/b"
+//       so when failed to create file, call mkdirs() and try again
+void _unzipToDir_mkdirs_parent(char* filePath) {
+    char* p = strrchr(filePath, DIR_SEPARATOR);
+    if (p == NULL) return;
+    p++; // make path ends with separator
+    char ch = *p;
+    *p = 0;
+    _my_dir_mkdirs(filePath);
+    *p = ch;
+}
+
+// disk space to reserve before writing entry [st], 0 if not needed
+uint64_t _unzipToDir_preallocate_size(const struct zip_stat* st) {
+    if (!(st->valid & ZIP_STAT_SIZE) || !(st->valid & ZIP_STAT_COMP_SIZE)) return 0;
+    if (st->size < UNZIP_PREALLOCATE_MIN_SIZE) return 0;
+    if (st->comp_size >= st->size / UNZIP_PREALLOCATE_MAX_RATIO) return st->size;
+    return st->comp_size * UNZIP_PREALLOCATE_MAX_RATIO;
+}
+
+// called once for each block of [job], even if the block is not inflated
+// [isDone] : the block [blockIndex] is inflated and written successfully
+void _unzipToDir_block_job_release(_my_unzip_block_job* job, uint32_t blockIndex, bool isDone) {
+    thd_mutex_lock(&job->mutex);
+    uint64_t offset = (uint64_t)blockIndex * job->blockIndex.blockSize;
+    if (!isDone && offset < job->validSize) job->validSize = offset;
+    bool isLast = --job->blocksLeft == 0;
+    thd_mutex_unlock(&job->mutex);
+    if (!isLast) return;
+
+    _my_unzip_task* task = job->task;
+    // release reserved space not written, the file is cut at the first block failed, e.g. cancelled
+    if (job->preallocated) my_file_truncate(job->fd, job->validSize);
+    my_file_close(job->fd);
+    if (job->mtime) my_file_set_lastWriteTime(job->filePath, false, job->mtime);
+    thd_mutex_lock(&task->progress_mutex);
+    if (task->progress.now_processing_filePath == job->filePath) {
+        task->progress.now_processing_filePath = (char*)"";
+    }
+    thd_mutex_unlock(&task->progress_mutex);
+    thd_mutex_destroy(&job->mutex);
+    free(job->filePath);
+    free(job);
+}
+
+void _unzipToDir_file_info_free(void* _info) {
+    _my_unzip_file_info* info = (_my_unzip_file_info*)_info;
+    while (info) {
+        _my_unzip_file_info* next = info->next;
+        if (info->job) _unzipToDir_block_job_release(info->job, info->blockIndex, false);
+        free(info);
+        info = next;
+    }
+}
+
+// called when an item popped from queue (entry, batch of entries, or block) is finished or dropped,
+// the queue is closed when all items are done, instead of pushing NULL for each thread at first,
+// because blocks of big entries are pushed into queue by threads during extracting
+void _unzipToDir_work_done(_my_unzip_task* task) {
+    thd_mutex_lock(&task->progress_mutex);
+    bool isAllDone = --task->pendingCount == 0;
+    thd_mutex_unlock(&task->progress_mutex);
+    if (isAllDone || task->isCancelled) mq_close(&task->mq); // wake up all threads waiting in mq_pop()
+}
+
+// inflate one block of a block indexed entry, and write it at its offset by my_file_pwrite()
+// NOTE: each block is an independent raw deflate stream, only the last one ends with Z_STREAM_END
+int _unzipToDir_unzipBlock(_my_unzip_task* task, _my_unzip_thread_context* ctx, _my_unzip_file_info* info) {
+    _my_unzip_block_job* job = info->job;
+    const MyZipBlockIndex* bi = &job->blockIndex;
+    bool isLast = info->blockIndex == bi->count - 1;
+    uint64_t compSize = my_zip_block_index_compressed_size(bi, info->blockIndex);
+    uint64_t outOffset = info->blockIndex * bi->blockSize;
+    uint64_t size = isLast ? job->size - outOffset : bi->blockSize;
+
+    if (ctx->inBuf == NULL) return ZIP_ER_MEMORY;
+    _my_unzip_raw_source src = { NULL, task->reader, info->blockDataOffset };
+    _my_unzip_input in;
+    MyFileIoRequest req; // writing the other output buffer by 'ring'
+    bool isWriting = false;
+    int nowOut = 0;
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) return ZIP_ER_MEMORY;
+
+    int err = 0;
+    int ret = Z_OK;
+    uint32_t crc = 0;
+    uint64_t totalInLen = 0;
+    uint64_t totalOutLen = 0;
+    _unzipToDir_input_init(&in, ctx, &src, compSize);
+    while (err == 0 && totalInLen < compSize && ret != Z_STREAM_END) {
+        if (task->isCancelled) break;
+        size_t len;
+        char* inBuf = _unzipToDir_input_next(&in, &len);
+        if (inBuf == NULL) {
+            err = ZIP_ER_READ;
+            break;
+        }
+        totalInLen += len;
+
+        stream.next_in = (Bytef*) inBuf;
+        stream.avail_in = (uInt) len;
+        do {
+            char* outBuf = ctx->outBufs[nowOut];
+            stream.next_out = (Bytef*) outBuf;
+            stream.avail_out = (uInt) UNZIP_OUTPUT_BUFFER_SIZE;
+            ret = inflate(&stream, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                err = ZIP_ER_COMPRESSED_DATA;
+                break;
+            }
+            size_t outLen = UNZIP_OUTPUT_BUFFER_SIZE - stream.avail_out;
+            if (totalOutLen + outLen > size) {
+                err = ZIP_ER_INCONS;
+                break;
+            }
+            crc = my_crc32(crc, outBuf, outLen);
+            if (outLen > 0 && ctx->ring) {
+                // write by 'ring' while inflating into the other buffer, at most one write in flight
+                if (isWriting && my_file_ring_wait_request(ctx->ring, &req) != 0) {
+                    isWriting = false;
+                    err = ZIP_ER_WRITE;
+                    break;
+                }
+                MyFileIoRequest r = { (int)(intptr_t)job->fd, true, outBuf, outLen, (int64_t)(outOffset + totalOutLen) };
+                req = r;
+                isWriting = my_file_ring_submit(ctx->ring, &req, 1) == 0;
+                if (!isWriting) {
+                    err = ZIP_ER_WRITE;
+                    break;
+                }
+                nowOut = !nowOut;
+            }
+            else if (outLen > 0 && my_file_pwrite(job->fd, outBuf, outLen, outOffset + totalOutLen) != 0) {
+                err = ZIP_ER_WRITE;
+                break;
+            }
+            totalOutLen += outLen;
+        } while (stream.avail_out == 0 && ret != Z_STREAM_END);
+    }
+    inflateEnd(&stream);
+    _unzipToDir_input_close(&in);
+    // NOTE: always wait, buffers are reused by next job, it also clears errors of this block from 'ring'
+    if (ctx->ring && my_file_ring_wait(ctx->ring) != 0 && err == 0) err = ZIP_ER_WRITE;
+
+    if (err == 0 && !task->isCancelled) {
+        if (isLast != (ret == Z_STREAM_END) || totalInLen != compSize) err = ZIP_ER_COMPRESSED_DATA;
+        else if (totalOutLen != size) err = ZIP_ER_INCONS;
+        else if (crc != my_zip_block_index_crc(bi, info->blockIndex)) err = ZIP_ER_CRC;
+    }
+    if (err == 0 && (task->flags & NZ_FLAG_NO_CACHE)) my_file_drop_cache(job->fd, outOffset, totalOutLen);
+
+    thd_mutex_lock(&task->progress_mutex);
+    task->progress.processed_fileSize += size;
+    task->progress.processed_compressSize += compSize;
+    thd_mutex_unlock(&task->progress_mutex);
+    return err;
+}
+
+// if entry [st] has a valid block index, create the file and push all its blocks into the front of queue,
+// so all threads inflate this entry together, instead of one thread inflates it while others are idle
+// return false if the entry should be inflated by one thread
+bool _unzipToDir_push_blocks(_my_unzip_task* task, const struct zip_stat* st, char* filePath, int* pErr) {
+    MyZipBlockIndex bi;
+    if (task->threadCount < 2 || st->comp_method != ZIP_CM_DEFLATE) return false;
+    if (!my_zip_reader_block_index(task->reader, st->index, &bi)) return false;
+
+    // all blocks crc must be the same as the entry crc, otherwise the index is not trusted
+    uint32_t crc = 0;
+    for (uint32_t i = 0; i < bi.count; i++) {
+        uint64_t len = i == bi.count - 1 ? st->size - i * bi.blockSize : bi.blockSize;
+        crc = (uint32_t)crc32_combine(crc, my_zip_block_index_crc(&bi, i), (z_off_t)len);
+    }
+    if (crc != st->crc) return false;
+
+    uint64_t dataOffset;
+    if ((*pErr = my_zip_reader_data_offset(task->reader, st->index, &dataOffset)) != 0) return true;
+    _my_unzip_block_job* job = (_my_unzip_block_job*)calloc(1, sizeof(_my_unzip_block_job));
+    char* path = job ? strdup(filePath) : NULL;
+    if (path == NULL) {
+        free(job);
+        *pErr = ZIP_ER_MEMORY;
+        return true;
+    }
+    job->fd = my_file_open_write(path);
+    if (job->fd == MY_FILE_INVALID_HANDLE) {
+        _unzipToDir_mkdirs_parent(path);
+        job->fd = my_file_open_write(path);
+    }
+    if (job->fd == MY_FILE_INVALID_HANDLE) {
+        free(path);
+        free(job);
+        *pErr = ZIP_ER_WRITE;
+        return true;
+    }
+    job->preallocated = _unzipToDir_preallocate_size(st);
+    if (job->preallocated) my_file_preallocate(job->fd, job->preallocated);
+    job->task = task;
+    job->filePath = path;
+    job->blockIndex = bi;
+    job->size = st->size;
+    job->validSize = st->size;
+    job->mtime = (st->valid & ZIP_STAT_MTIME) ? st->mtime : 0;
+    job->blocksLeft = bi.count;
+    thd_mutex_init(&job->mutex);
+    thd_mutex_lock(&task->progress_mutex);
+    task->progress.now_processing_filePath = path;
+    task->pendingCount += bi.count; // before pushed, so queue is not closed by other threads now
+    thd_mutex_unlock(&task->progress_mutex);
+
+    // push in reverse order, so blocks are popped from the first one
+    uint64_t blockDataOffset = dataOffset + st->comp_size;
+    for (uint32_t i = bi.count; i-- > 0;) {
+        blockDataOffset -= my_zip_block_index_compressed_size(&bi, i);
+        _my_unzip_file_info* info = (_my_unzip_file_info*)calloc(1, sizeof(_my_unzip_file_info));
+        if (info) {
+            info->index = st->index;
+            info->job = job;
+            info->blockIndex = i;
+            info->blockDataOffset = blockDataOffset;
+        }
+        if (info == NULL || mq_push_front(&task->mq, info) != 0) { // no memory, or queue is closed by cancelled
+            free(info);
+            if (!task->isCancelled) *pErr = ZIP_ER_MEMORY;
+            for (uint32_t k = 0; k <= i; k++) { // blocks never pushed
+                _unzipToDir_block_job_release(job, k, false);
+                _unzipToDir_work_done(task);
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+int _unzipToDir_unzipEntry(_my_unzip_task* task, _my_unzip_thread_context* ctx, _my_unzip_file_info* info) {
     struct zip_stat st;
     int err = 0;
 
-    err = zip_stat_index(zip, info->index, 0, &st);
-    if (err != 0) return ERR_NZ_ZIP_ENTRY_NOT_FOUND;
+    zip_t* zip = NULL; // NULL if read by 'task->reader'
+    if (!_unzipToDir_reader_stat(task, info->index, &st)) {
+        zip = _unzipToDir_thread_zip(task, ctx);
+        if (zip == NULL) return ZIP_ER_OPEN;
+        err = zip_stat_index(zip, info->index, 0, &st);
+        if (err != 0) return ERR_NZ_ZIP_ENTRY_NOT_FOUND;
+    }
 
     if (_my_zip_is_malicious_path(st.name)) return ERR_NZ_ZIP_HAS_MALICIOUS_PATH; // malicious path, exit
 
@@ -509,51 +1823,48 @@ int _unzipToDir_unzipEntry(_my_unzip_task* task, zip_t* zip, _my_unzip_file_info
     }
 
     if (task->isCancelled) return 0;
-    zip_file_t* zf = zip_fopen_index(zip, info->index, 0);
-    if (!zf) return ZIP_ER_OPEN;
+    if (zip == NULL && _unzipToDir_push_blocks(task, &st, newFilePath, &err)) return err;
+    bool isRaw = _unzipToDir_can_read_raw(&st);
+    _my_unzip_raw_source src = { NULL, task->reader, 0 };
+    zip_file_t* zf = NULL;
+    if (zip) {
+        zf = zip_fopen_index(zip, info->index, isRaw ? ZIP_FL_COMPRESSED : 0);
+        if (!zf) return ZIP_ER_OPEN;
+        src.zf = zf;
+    }
+    else if ((err = my_zip_reader_data_offset(task->reader, info->index, &src.offset)) != 0) {
+        return err;
+    }
 
     FILE* fout;
     _my_file_fopen(&fout, newFilePath, "wb");
     if (!fout) {
-        // NOTE: zip file format allow a file entry path like "a/b/c.txt"
-        //       without directory entry "a" and "a/b"
-        //       so when fopen() fails, call mkdirs() and try again
-        char* p = strrchr(newFilePath, DIR_SEPARATOR);
-        if (p != NULL) {
-            p++; // make path ends with separator
-            char ch = *p;
-            *p = 0;
-            err = _my_dir_mkdirs(newFilePath);
-            if (err != 0) {
-                err = -1;
-            }
-            *p = ch;
-        }
-
+        _unzipToDir_mkdirs_parent(newFilePath);
         _my_file_fopen(&fout, newFilePath, "wb");
         if (!fout) {
-            zip_fclose(zf);
+            if (zf) zip_fclose(zf);
             return ZIP_ER_WRITE;
         }
     }
 
     // write file
-    char buf[1024 * 16];
-    zip_uint64_t sum = 0;
-    while (sum < st.size) {
-        if (task->isCancelled) break;
-        zip_int64_t len = zip_fread(zf, buf, sizeof(buf));
-        if (len < 0) {
-            err = ZIP_ER_READ;
-            break;
-        }
-        fwrite(buf, 1, len, fout);
-        sum += len;
-    }
+    // NOTE: not buffered by stdio, data are written from the output buffer (1MB) directly
+    setvbuf(fout, NULL, _IONBF, 0);
+    bool isSizeKnown = (st.valid & ZIP_STAT_SIZE) != 0;
+    uint64_t preallocated = _unzipToDir_preallocate_size(&st);
+    if (preallocated) my_file_preallocate(my_file_get_handle(fout), preallocated);
+    _my_unzip_output out;
+    _unzipToDir_output_init(&out, ctx, fout, (task->flags & NZ_FLAG_NO_CACHE) && isSizeKnown && st.size >= UNZIP_NO_CACHE_MIN_SIZE);
+    if (ctx->inBuf == NULL) err = ZIP_ER_MEMORY;
+    else if (isRaw) err = _unzipToDir_write_raw_entry(task, ctx, &src, &st, &out);
+    else err = _unzipToDir_write_entry(task, zf, &st, &out);
+    err = _unzipToDir_output_close(&out, err);
+    // release reserved space not written, e.g. failed, cancelled, or the entry is smaller than its size in central directory
+    if (preallocated) my_file_truncate(my_file_get_handle(fout), (uint64_t)out.offset);
 
     // cleanup
     fclose(fout);
-    zip_fclose(zf);
+    if (zf) zip_fclose(zf);
     if (st.valid & ZIP_STAT_MTIME) my_file_set_lastWriteTime(newFilePath, false, st.mtime);
 
 
@@ -569,52 +1880,49 @@ int _unzipToDir_unzipEntry(_my_unzip_task* task, zip_t* zip, _my_unzip_file_info
     return err;
 }
 
+// [zip] : libzip handle used by this thread, or NULL to open one when needed
 int _unzipToDir_consume_queue(_my_unzip_task* task, zip_t *zip) {
     int err = 0;
     _my_unzip_file_info* info = NULL;
+    _my_unzip_thread_context ctx;
+    _unzipToDir_thread_context_init(&ctx, zip);
     while (1) {
-        FREEIF(info);
         info = (_my_unzip_file_info*)mq_pop(&task->mq);
-        if (info == NULL) break; // end of queue
+        if (info == NULL) break; // queue is closed, all done or cancelled
 
-        if (task->isCancelled) break;
-        err = _unzipToDir_unzipEntry(task, zip, info);
+        if (task->isCancelled) {
+            _unzipToDir_file_info_free(info);
+            _unzipToDir_work_done(task); // close queue to wake up other threads, items left are freed by mq_destroy()
+            break;
+        }
+        if (info->job) {
+            err = _unzipToDir_unzipBlock(task, &ctx, info);
+            _unzipToDir_block_job_release(info->job, info->blockIndex, err == 0 && !task->isCancelled);
+            info->job = NULL;
+        }
+        else {
+            for (_my_unzip_file_info* p = info; p && err == 0 && !task->isCancelled; p = p->next) {
+                err = _unzipToDir_unzipEntry(task, &ctx, p);
+            }
+        }
+        _unzipToDir_file_info_free(info);
         if (err != 0) { 
             task->errCode = err;
             task->isCancelled = true;
-            break;
         }
+        _unzipToDir_work_done(task);
+        if (err != 0) break;
     }
-    FREEIF(info);
+    _unzipToDir_thread_context_destroy(&ctx);
     return err;
 }
 
 void _unzipToDir_copy_thread(void* _task) {
     _my_unzip_task* task = (_my_unzip_task*)_task;
-
-    int err;
-    zip_t* zip = zip_open(task->zipFilePath, ZIP_RDONLY, &err);
-    if (!zip) {
-        task->errCode = ZIP_ER_OPEN;
-        task->isCancelled = true;
-        return;
-    }
-    
-    if (task->password) {
-        err = zip_set_default_password(zip, task->password);
-        if (err) {
-            task->errCode = ZIP_ER_WRONGPASSWD;
-            task->isCancelled = true;
-            my_zip_close(zip);
-            return;
-        }
-    }
-
-    err = _unzipToDir_consume_queue(task, zip);
+    int err = _unzipToDir_consume_queue(task, NULL);
     if (err) {
         task->errCode = err;
     }
-    my_zip_close(zip);
 }
 
 int _unzipToDir_dirs_set_mtime(_my_unzip_task* task, zip_t* zip) {
@@ -661,48 +1969,89 @@ const bool _unzipDir_path_is_direactory(const char *path) {
     return path[strlen(path) - 1] == ZIP_PATH_SEPARATOR;
 }
 
-void _unzipDir_add_file_into_queue(_my_unzip_task* task, zip_int64_t index, size_t basePathLen) {
-    _my_unzip_file_info* info = (_my_unzip_file_info*)malloc(sizeof(_my_unzip_file_info));
+#define UNZIP_BATCH_FILE_SIZE (1024 * 64) // entries smaller than this are batched
+#define UNZIP_BATCH_MAX_SIZE (1024 * 1024)
+#define UNZIP_BATCH_MAX_COUNT 64
+
+typedef struct _my_unzip_file_list { // entries to be extracted, pushed into queue after sorted by size
+    _my_unzip_file_info* items;
+    size_t count;
+    size_t capacity;
+} _my_unzip_file_list;
+
+int _unzipDir_add_file_into_list(_my_unzip_file_list* list, zip_int64_t index, size_t basePathLen, uint64_t size) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        _my_unzip_file_info* items = (_my_unzip_file_info*)realloc(list->items, capacity * sizeof(_my_unzip_file_info));
+        if (items == NULL) return ZIP_ER_MEMORY;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    _my_unzip_file_info* info = &list->items[list->count++];
+    memset(info, 0, sizeof(_my_unzip_file_info));
     info->index = index;
     info->basePathLen = basePathLen;
-    mq_push(&task->mq, (void*)info);
+    info->size = size;
+    return 0;
 }
 
-int unzipToDir(_my_unzip_task *task, void* _zip, const char *zipFilePath, char **entryPathsArr, int entriesCount, const char *toDirPath, int threadCount) {
-    // [entryPathsArr] : all the entry paths must be in the same directory !
-    // [zipFilePath] : must be the path of [_zip], used to open zip file in each thread
-    // return '_my_unzip_task' object
-    if (threadCount < 1) threadCount = 1;
-    if (entriesCount < 1) return ERR_NZ_INVALID_ARGUMENT;
-
-    zip_t* zip = (zip_t*)_zip;
-    task->zip = zip;
-    task->isCancelled = false;
-    task->progress.now_processing_filePath = (char*)"";
+int _unzipDir_file_info_compare(const void* a, const void* b) {
+    const _my_unzip_file_info* x = (const _my_unzip_file_info*)a;
+    const _my_unzip_file_info* y = (const _my_unzip_file_info*)b;
+    if (x->size != y->size) return x->size > y->size ? -1 : 1; // bigger first
+    return x->index < y->index ? -1 : (x->index > y->index ? 1 : 0);
+}
 
-    /*
-    // check if all the entry path are in the same directory
-    char *firstEntryPath = NULL;
-    int baseDirectoryPathLen = 0;
-    for (int i=0; i<entriesCount; i++) {
-        char *entryPath = entryPathsArr[i];
-        if (_my_zip_is_malicious_path(entryPath)) return ERR_NZ_INVALID_PATH; // malicious path, exit
+// push the biggest entries first, so a huge entry at the end of .zip is not extracted by one thread while others are idle,
+// and small entries fill the gaps at last, in batches, so threads don't mq_pop() for each tiny file
+// NOTE: called before threads started, so 'pendingCount' is updated without lock
+int _unzipDir_push_files_into_queue(_my_unzip_task* task, _my_unzip_file_list* list) {
+    if (list->count > 1) qsort(list->items, list->count, sizeof(_my_unzip_file_info), _unzipDir_file_info_compare);
+    _my_unzip_file_info* batch = NULL;
+    _my_unzip_file_info* batchTail = NULL;
+    size_t batchCount = 0;
+    uint64_t batchSize = 0;
+    for (size_t i = 0; i <= list->count; i++) {
+        _my_unzip_file_info* item = i < list->count ? &list->items[i] : NULL;
+        bool isSmall = item && item->size < UNZIP_BATCH_FILE_SIZE;
+        if (batch && (!isSmall || batchCount == UNZIP_BATCH_MAX_COUNT || batchSize >= UNZIP_BATCH_MAX_SIZE)) {
+            if (mq_push(&task->mq, (void*)batch) != 0) {
+                _unzipToDir_file_info_free(batch);
+                return ZIP_ER_MEMORY;
+            }
+            task->pendingCount++;
+            batch = batchTail = NULL;
+            batchCount = 0;
+            batchSize = 0;
+        }
+        if (item == NULL) break;
 
-        if (i==0) {
-            firstEntryPath = entryPath;
-            baseDirectoryPathLen = _unzipDir_get_base_directory_len_from_path(entryPath);
-        } else {
-            // check if all the entry path are in the same directory
-            if (_unzipDir_get_base_directory_len_from_path(entryPath) != baseDirectoryPathLen) return ERR_NZ_INVALID_PATH;
-            if (strncmp(firstEntryPath, entryPath, baseDirectoryPathLen) != 0) return ERR_NZ_INVALID_PATH;
+        _my_unzip_file_info* info = (_my_unzip_file_info*)malloc(sizeof(_my_unzip_file_info));
+        if (info == NULL) {
+            _unzipToDir_file_info_free(batch);
+            return ZIP_ER_MEMORY;
+        }
+        *info = *item;
+        if (!isSmall) {
+            if (mq_push(&task->mq, (void*)info) != 0) {
+                free(info);
+                _unzipToDir_file_info_free(batch);
+                return ZIP_ER_MEMORY;
+            }
+            task->pendingCount++;
+            continue;
         }
+        if (batchTail) batchTail->next = info;
+        else batch = info;
+        batchTail = info;
+        batchCount++;
+        batchSize += info->size;
     }
-    // TODO: check if there are two identical paths ?
-    */
-
+    return 0;
+}
 
-    // add all entry index that need to be copied into message queue
-    mq_init(&task->mq); // TODO: call mq_destroy() before return in some cases...
+// find entries to be extracted by [entryPathsArr]
+int _unzipDir_find_files(_my_unzip_task* task, zip_t* zip, char** entryPathsArr, int entriesCount, _my_unzip_file_list* list) {
     struct zip_stat st;
     zip_stat_init(&st);
     for (int k=0; k<entriesCount; k++) {
@@ -712,12 +2061,13 @@ int unzipToDir(_my_unzip_task *task, void* _zip, const char *zipFilePath, char *
         if (!isDir && entryPath[0] != '\0') { // entryPath is a file
             zip_int64_t entryIndex = zip_name_locate(zip, entryPath, ZIP_FL_ENC_UTF_8);
             if (entryIndex < 0) return ERR_NZ_ZIP_ENTRY_NOT_FOUND;
-            
+            if (zip_stat_index(zip, entryIndex, 0, &st) != 0) return ERR_NZ_ZIP_ENTRY_NOT_FOUND;
+
             size_t entryPathLen = 0;
             char* lastSeparator = strrchr(entryPath, '/');
             if (lastSeparator) entryPathLen = lastSeparator - entryPath + 1;
             else entryPathLen = 0;
-            _unzipDir_add_file_into_queue(task, entryIndex, entryPathLen);
+            if (_unzipDir_add_file_into_list(list, entryIndex, entryPathLen, (st.valid & ZIP_STAT_SIZE) ? st.size : 0) != 0) return ZIP_ER_MEMORY;
             continue;
         }
 
@@ -730,38 +2080,93 @@ int unzipToDir(_my_unzip_task *task, void* _zip, const char *zipFilePath, char *
             if (strncmp(st.name, entryPath, entryPathLen) != 0) continue;
 
             if (st.valid & ZIP_STAT_SIZE) task->progress.total_fileSize += st.size;
-            _unzipDir_add_file_into_queue(task, st.index, entryPathLen);
+            if (_unzipDir_add_file_into_list(list, st.index, entryPathLen, (st.valid & ZIP_STAT_SIZE) ? st.size : 0) != 0) return ZIP_ER_MEMORY;
             isFound = true;
         }
         if (!isFound) return ERR_NZ_ZIP_ENTRY_NOT_FOUND;
     }
+    return 0;
+}
+
+int unzipToDir(_my_unzip_task *task, void* _zip, const char *zipFilePath, char **entryPathsArr, int entriesCount, const char *toDirPath, int threadCount) {
+    // [entryPathsArr] : all the entry paths must be in the same directory !
+    // [zipFilePath] : must be the path of [_zip], used to open zip file in each thread
+    // return '_my_unzip_task' object
+    if (threadCount < 1) threadCount = my_sysinfo_get_cpu_count(); // auto
+    if (entriesCount < 1) return ERR_NZ_INVALID_ARGUMENT;
+
+    zip_t* zip = (zip_t*)_zip;
+    task->zip = zip;
+    task->threadCount = threadCount;
+    task->isCancelled = false;
+    task->progress.now_processing_filePath = (char*)"";
+
+    /*
+    // check if all the entry path are in the same directory
+    char *firstEntryPath = NULL;
+    int baseDirectoryPathLen = 0;
+    for (int i=0; i<entriesCount; i++) {
+        char *entryPath = entryPathsArr[i];
+        if (_my_zip_is_malicious_path(entryPath)) return ERR_NZ_INVALID_PATH; // malicious path, exit
+
+        if (i==0) {
+            firstEntryPath = entryPath;
+            baseDirectoryPathLen = _unzipDir_get_base_directory_len_from_path(entryPath);
+        } else {
+            // check if all the entry path are in the same directory
+            if (_unzipDir_get_base_directory_len_from_path(entryPath) != baseDirectoryPathLen) return ERR_NZ_INVALID_PATH;
+            if (strncmp(firstEntryPath, entryPath, baseDirectoryPathLen) != 0) return ERR_NZ_INVALID_PATH;
+        }
+    }
+    // TODO: check if there are two identical paths ?
+    */
+
+
+    // add all entry index that need to be copied into message queue
+    mq_init(&task->mq); // TODO: call mq_destroy() before return in some cases...
+    task->pendingCount = 0;
+    _my_unzip_file_list list = { NULL, 0, 0 };
+    int listErr = _unzipDir_find_files(task, zip, entryPathsArr, entriesCount, &list);
+    if (listErr == 0) listErr = _unzipDir_push_files_into_queue(task, &list);
+    free(list.items);
+    if (listErr != 0) return listErr;
 
 
     task->zipFilePath = zipFilePath;
     task->dirPath = toDirPath;
 
+    // parse central directory once for all threads, instead of zip_open() in each thread,
+    // only if it is the same as [_zip], e.g. no entries added into [_zip] but not saved yet
+    MyZipReader reader;
+    task->reader = NULL;
+    if (zipFilePath && my_zip_reader_open(&reader, zipFilePath) == 0) {
+        if ((zip_uint64_t)zip_get_num_entries(zip, 0) == reader.entriesCount) task->reader = &reader;
+        else my_zip_reader_close(&reader);
+    }
+
     // start to copy files in threads
     thd_mutex_init(&task->progress_mutex);
     int err = 0;
     do {
         if (task->isCancelled) break;
+        if (task->pendingCount == 0) mq_close(&task->mq); // nothing to extract
         err = simple_thread_pool_create(&task->pool, threadCount - 1, _unzipToDir_copy_thread, task);
         if (err != 0) {
+            task->isCancelled = true;
+            mq_close(&task->mq); // threads already created exit now
             err = ERR_NZ_INTERNAL_ERROR;
             break;
         }
 
-        for (int i = 0; i < threadCount; i++) {
-            mq_push(&task->mq, (void*)NULL); // finish signal for each thread
-        }
-
         if (task->isCancelled) break;
         _unzipToDir_consume_queue(task, zip);
     } while (0);
 
     simple_thread_pool_destroy(&task->pool); // wait for all thread finish
+    mq_destroy(&task->mq, _unzipToDir_file_info_free); // NOTE: blocks left in queue if cancelled
     thd_mutex_destroy(&task->progress_mutex);
-    mq_destroy(&task->mq, free);
+    if (task->reader) my_zip_reader_close(task->reader);
+    task->reader = NULL;
 
     if (task->errCode) err = task->errCode;
     if (task->isCancelled) return err;
@@ -903,8 +2308,8 @@ int zipDir_ez(const char* dirPath, const char* zipFilepath, bool skipTopLevel, i
     if (zip == NULL) return ZIP_ER_EXISTS;
 
     const char* entryPathsArr[] = { dirPath };
-    _my_zip_task task = { .compressLevel = 5 };
-    int err = zipDir(&task, zip, entryPathsArr, 1, "", skipTopLevel, threadCount);
+    _my_zip_task task = { .compressLevel = 5, .flags = NZ_FLAG_STORE_BY_EXTENSION | NZ_FLAG_STORE_BY_MAGIC | NZ_FLAG_STORE_BY_SAMPLE };
+    int err = zipDir(&task, zip, zipFilepath, entryPathsArr, 1, "", skipTopLevel, threadCount);
     if (!task.isZipClosed) {
         if (err) zip_discard(zip);
         else my_zip_close(zip);
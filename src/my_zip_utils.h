@@ -5,9 +5,18 @@
 #include "my_message_queue.h"
 #include "my_atomic_int_max.h"
 #include "my_threadpool.h"
+#include "my_zip_writer.h"
+#include "my_zip_reader.h"
+#include "my_buffer_pool.h"
 
 #include <zip.h>
 
+// max count of blocks (or batches of small files) waiting to compress, threads compress the largest one first
+#define ZIP_SCHEDULE_WINDOW_SIZE 64
+
+// with NZ_FLAG_ADAPTIVE_THREADS, measure compress throughput in each interval, and change active thread count by one
+#define ZIP_ADAPT_INTERVAL_MS 250
+
 typedef struct {
     char* now_processing_filePath; // DO NOT free this
     size_t total_fileSize;
@@ -20,17 +29,49 @@ typedef struct {
 
     zip_t* zip;
     int compressLevel;
-    bool hasPassword;
+    int compressMethod; // ZIP_CM_DEFLATE or ZIP_CM_ZSTD, 0 means ZIP_CM_DEFLATE
+    const struct MyCompressBackend* compressBackend; // compressor of 'compressMethod'
+    int flags; // values in [NativeZipFlags]
+    const char* password; // NULL if no password, DON'T free()
     bool isZipClosed; // is zip_close() called in zipDir()
-    long maxBlockSize; // max file block size to compress
+    size_t maxBlockSize; // max file block size to compress, 0 means auto
+    size_t maxMemoryUsage; // max memory used by blocks compressing / waiting to write, 0 means auto
+    zip_int64_t originalEntriesCount; // entries count in zip before zipDir(), entries with index >= this are added by this task
 
     const char* entryDirPathBase; // zip files to which dir path in .zip file, DON't free()
     Queue queue_cb_data;
     MessageQueue mq_blocks; // all '_my_zip_block' need to compress by threads
-    thd_mutex mq_blocksMutex;
+    thd_mutex mq_blocksMutex; // also protect 'window', 'windowPending' and 'isBlocksEnd'
+    struct _my_zip_block* window[ZIP_SCHEDULE_WINDOW_SIZE]; // popped from 'mq_blocks' with memory reserved, not compressing yet, in archive order
+    int windowCount;
+    struct _my_zip_block* windowPending; // popped from 'mq_blocks', but memory is not reserved yet
+    bool isBlocksEnd; // NULL popped from 'mq_blocks', no more blocks
+    int threadCount; // compress threads created
+    int nextThreadId;
+    int activeThreadCount; // with NZ_FLAG_ADAPTIVE_THREADS, threads with id >= this are idle, protected by 'mq_blocksMutex'
+    thd_condition activeThreadCond; // signaled when 'activeThreadCount' grows or no more blocks
+    uint64_t adaptStartTime; // start time (ms) of the current throughput measuring interval
+    uint64_t adaptBytes; // bytes compressed in the current interval
+    double adaptLastRate; // bytes per ms of the previous interval
+    int adaptStep; // last change of 'activeThreadCount', +1 or -1
+    thd_mutex blockDoneMutex;
+    thd_condition blockDoneCond; // signaled when any '_my_zip_block->isCompressDone' set to true
     atomic_int_max_t nowMemoryUsage; // current memory used by all '_my_zip_block->compressedData'
+    struct _my_zip_block* smallBlocksHead; // small files not pushed into 'mq_blocks' yet, linked by 'nextSmallBlock'
+    struct _my_zip_block* smallBlocksTail;
+    size_t smallBlocksSize; // total size of small files in 'smallBlocksHead'
+    size_t smallBlocksBatchSize; // push small files into 'mq_blocks' before 'smallBlocksSize' exceeds this
+
+    thd_mutex encryptMutex; // protect '_my_zip_callback_data->nextEncryptBlock'
+    thd_mutex storeDetectMutex; // protect '_my_zip_callback_data->storeDetectState'
+    thd_condition storeDetectCond; // signaled when any file is detected by compress thread
+
+    BufferPool blockBufferPool; // recycle '_my_zip_block->compressedData' buffers, and track blocks not freed
 
-    atomic_int_max_t allocatedBlocksTracker;
+    MyZipWriter* writer; // if not NULL, write entries by 'writer' instead of libzip
+    bool isBlockIndexed; // with NZ_FLAG_BLOCK_INDEX, blocks are compressed independently and recorded by 'writer'
+    MessageQueue mq_entries; // all '_my_zip_callback_data' need to write by 'writer', in order
+    HashMap* entryNames; // entry paths found by traversal, only used with 'writer' (libzip path uses zip_name_locate())
 } _my_zip_task;
 
 typedef struct _my_unzip_task {
@@ -41,12 +82,16 @@ typedef struct _my_unzip_task {
     const char* password;
     const char* zipFilePath;
     const char* dirPath;
+    MyZipReader* reader; // central directory shared by all threads, NULL if not parsed, then threads use libzip
+    int threadCount;
+    int flags; // NativeZipFlags
     MessageQueue mq;
+    size_t pendingCount; // entries, batches and blocks in 'mq' or being extracted, protected by 'progress_mutex', 'mq' is closed when it becomes 0
     SimpleThreadPool pool;
 } _my_unzip_task;
 
 
-int zipDir(_my_zip_task* task, void* _zip, const char** dirPathList, int dirPathListCount, const char* entryDirPathBase, bool skipTopLevel, int threadCount);
+int zipDir(_my_zip_task* task, void* _zip, const char* zipFilePath, const char** dirPathList, int dirPathListCount, const char* entryDirPathBase, bool skipTopLevel, int threadCount);
 int unzipToDir(_my_unzip_task* task, void* _zip, const char* zipFilePath, char** entryPathsArr, int entriesCount, const char* toDirPath, int threadCount);
 int zipRemoveEntries(zip_t* zip, const char** entryPaths, int entriesCount);
 int zipRenameEntry(zip_t* zip, const char* entryPath, const char* newEntryPath);
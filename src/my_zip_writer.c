@@ -0,0 +1,421 @@
+#include "my_zip_writer.h"
+#include "my_hashmap.h"
+#include "my_file.h"
+#include "my_common.h"
+#include "native_zip.h"
+
+#include <zip.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ref: https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+
+#define ZIP_SIG_LOCAL_HEADER 0x04034b50
+#define ZIP_SIG_CENTRAL_HEADER 0x02014b50
+#define ZIP_SIG_EOCD 0x06054b50
+#define ZIP_SIG_ZIP64_EOCD 0x06064b50
+#define ZIP_SIG_ZIP64_EOCD_LOCATOR 0x07064b50
+
+#define ZIP_FLAG_UTF8 0x0800 // general purpose bit 11: filename is utf-8
+#define ZIP_FLAG_ENCRYPTED 0x0001
+#define ZIP_VERSION_DEFAULT 20
+#define ZIP_VERSION_ZIP64 45
+#define ZIP_VERSION_AES 51
+#define ZIP_VERSION_MADE_BY_UNIX (3 << 8)
+
+#define ZIP_MAX_16 0xFFFF
+#define ZIP_MAX_32 0xFFFFFFFFULL
+
+// WinZip AES extra field, the method in header is 99, and the actual compression method is stored here
+// ref: https://www.winzip.com/en/support/aes-encryption/
+#define ZIP_CM_WINZIP_AES 99
+#define ZIP_EXTRA_WINZIP_AES 0x9901
+#define ZIP_EXTRA_WINZIP_AES_SIZE 11
+#define ZIP_WINZIP_AES_STRENGTH_256 3
+
+// files larger than this use zip64 local header, because compressed data may be a little larger than original data
+#define ZIP64_LOCAL_THRESHOLD 0xF0000000ULL
+
+static void _put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void _put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void _put64(uint8_t* p, uint64_t v) {
+    _put32(p, (uint32_t)v);
+    _put32(p + 4, (uint32_t)(v >> 32));
+}
+
+static void _my_zip_writer_dos_time(time_t t, uint16_t* dosTime, uint16_t* dosDate) {
+    struct tm tmv;
+#ifdef _WIN32
+    localtime_s(&tmv, &t);
+#else
+    localtime_r(&t, &tmv);
+#endif
+    if (tmv.tm_year < 80) { // dos time starts from 1980
+        *dosTime = 0;
+        *dosDate = (1 << 5) | 1;
+        return;
+    }
+    *dosTime = (uint16_t)((tmv.tm_hour << 11) | (tmv.tm_min << 5) | (tmv.tm_sec >> 1));
+    *dosDate = (uint16_t)(((tmv.tm_year - 80) << 9) | ((tmv.tm_mon + 1) << 5) | tmv.tm_mday);
+}
+
+static int _my_zip_writer_write(MyZipWriter* writer, const void* data, size_t len) {
+    if (len == 0) return 0;
+    if (fwrite(data, 1, len, writer->fp) != len) return ZIP_ER_WRITE;
+    writer->offset += len;
+    return 0;
+}
+
+static int _my_zip_writer_pwrite(MyZipWriter* writer, uint64_t offset, const void* data, size_t len) {
+    // overwrite data written before, then seek back to the end of file
+    if (my_file_fseek64(writer->fp, offset, SEEK_SET) != 0) return ZIP_ER_SEEK;
+    if (fwrite(data, 1, len, writer->fp) != len) return ZIP_ER_WRITE;
+    if (my_file_fseek64(writer->fp, writer->offset, SEEK_SET) != 0) return ZIP_ER_SEEK;
+    return 0;
+}
+
+static uint16_t _my_zip_writer_flags(_my_zip_writer_entry* entry) {
+    return entry->aesVersion ? ZIP_FLAG_UTF8 | ZIP_FLAG_ENCRYPTED : ZIP_FLAG_UTF8;
+}
+
+static uint16_t _my_zip_writer_method(_my_zip_writer_entry* entry) {
+    return entry->aesVersion ? ZIP_CM_WINZIP_AES : entry->method;
+}
+
+static void _my_zip_writer_put_aes_extra(uint8_t* p, _my_zip_writer_entry* entry) {
+    _put16(p, ZIP_EXTRA_WINZIP_AES);
+    _put16(p + 2, ZIP_EXTRA_WINZIP_AES_SIZE - 4);
+    _put16(p + 4, entry->aesVersion);
+    p[6] = 'A';
+    p[7] = 'E';
+    p[8] = ZIP_WINZIP_AES_STRENGTH_256;
+    _put16(p + 9, entry->method);
+}
+
+static _my_zip_writer_entry* _my_zip_writer_new_entry(MyZipWriter* writer, const char* name, time_t mtime, int* err) {
+    if (hashmap_find(writer->names, name) != NULL) {
+        *err = ERR_NZ_ZIP_ENTRY_ALREADY_EXISTS;
+        return NULL;
+    }
+
+    if (writer->entriesCount == writer->entriesCapacity) {
+        size_t capacity = writer->entriesCapacity ? writer->entriesCapacity * 2 : 1024;
+        _my_zip_writer_entry* entries = (_my_zip_writer_entry*)realloc(writer->entries, capacity * sizeof(_my_zip_writer_entry));
+        if (entries == NULL) {
+            *err = ZIP_ER_MEMORY;
+            return NULL;
+        }
+        writer->entries = entries;
+        writer->entriesCapacity = capacity;
+    }
+
+    _my_zip_writer_entry* entry = &writer->entries[writer->entriesCount++];
+    memset(entry, 0, sizeof(_my_zip_writer_entry));
+    entry->name = strdup(name);
+    entry->localHeaderOffset = writer->offset;
+    entry->versionNeeded = ZIP_VERSION_DEFAULT;
+    _my_zip_writer_dos_time(mtime, &entry->dosTime, &entry->dosDate);
+    hashmap_insert(writer->names, name, (void*)1);
+    *err = 0;
+    return entry;
+}
+
+static int _my_zip_writer_write_local_header(MyZipWriter* writer, _my_zip_writer_entry* entry) {
+    uint8_t hdr[30 + 20 + ZIP_EXTRA_WINZIP_AES_SIZE];
+    size_t nameLen = strlen(entry->name);
+    if (nameLen > ZIP_MAX_16) return ERR_NZ_INVALID_PATH;
+    uint16_t zip64ExtraLen = entry->hasZip64LocalExtra ? 20 : 0;
+    uint16_t extraLen = zip64ExtraLen + (entry->aesVersion ? ZIP_EXTRA_WINZIP_AES_SIZE : 0);
+
+    _put32(hdr, ZIP_SIG_LOCAL_HEADER);
+    _put16(hdr + 4, entry->versionNeeded);
+    _put16(hdr + 6, _my_zip_writer_flags(entry));
+    _put16(hdr + 8, _my_zip_writer_method(entry));
+    _put16(hdr + 10, entry->dosTime);
+    _put16(hdr + 12, entry->dosDate);
+    _put32(hdr + 14, entry->crc);
+    if (entry->hasZip64LocalExtra) {
+        _put32(hdr + 18, (uint32_t)ZIP_MAX_32);
+        _put32(hdr + 22, (uint32_t)ZIP_MAX_32);
+    }
+    else {
+        _put32(hdr + 18, (uint32_t)entry->compressedSize);
+        _put32(hdr + 22, (uint32_t)entry->uncompressedSize);
+    }
+    _put16(hdr + 26, (uint16_t)nameLen);
+    _put16(hdr + 28, extraLen);
+
+    int err = _my_zip_writer_write(writer, hdr, 30);
+    if (!err) err = _my_zip_writer_write(writer, entry->name, nameLen);
+    if (!err && extraLen > 0) {
+        // NOTE: zip64 extra field must be the first one, its position is used by my_zip_writer_end_file()
+        uint8_t* extra = hdr + 30;
+        if (entry->hasZip64LocalExtra) {
+            _put16(extra, 0x0001); // zip64 extended information extra field
+            _put16(extra + 2, 16);
+            _put64(extra + 4, entry->uncompressedSize);
+            _put64(extra + 12, entry->compressedSize);
+        }
+        if (entry->aesVersion) _my_zip_writer_put_aes_extra(extra + zip64ExtraLen, entry);
+        err = _my_zip_writer_write(writer, extra, extraLen);
+    }
+    return err;
+}
+
+// --------------------------------------------------------------------------
+
+int my_zip_writer_open(MyZipWriter* writer, const char* path) {
+    memset(writer, 0, sizeof(MyZipWriter));
+    _my_file_fopen(&writer->fp, path, "wb");
+    if (writer->fp == NULL) return ZIP_ER_OPEN;
+    setvbuf(writer->fp, NULL, _IOFBF, 1024 * 1024); // many small files, reduce write() calls
+    writer->names = hashmap_create(1024);
+    return 0;
+}
+
+int my_zip_writer_add_dir(MyZipWriter* writer, const char* name, time_t mtime) {
+    // [name] must ends with '/'
+    int err = 0;
+    _my_zip_writer_entry* entry = _my_zip_writer_new_entry(writer, name, mtime, &err);
+    if (entry == NULL) return err;
+
+    entry->method = ZIP_CM_STORE;
+    entry->isDataKnown = true;
+    entry->externalAttr = (040755u << 16) | 0x10; // unix mode, and MS-DOS directory attribute
+    return _my_zip_writer_write_local_header(writer, entry);
+}
+
+int my_zip_writer_begin_file(MyZipWriter* writer, const char* name, time_t mtime, uint32_t mode, uint16_t method, uint64_t uncompressedSize, bool isDataKnown, uint32_t crc, uint64_t compressedSize, uint16_t aesVersion) {
+    // if [isDataKnown] is false, [crc] and [compressedSize] are ignored,
+    // and will be updated by my_zip_writer_end_file() after all data written
+    // if [aesVersion] is not 0, data is encrypted by caller (including salt, password verifier and auth code) and [method] is the actual method
+    // [mode] is unix permission bits of the file, 0 means default (0644)
+    int err = 0;
+    _my_zip_writer_entry* entry = _my_zip_writer_new_entry(writer, name, mtime, &err);
+    if (entry == NULL) return err;
+
+    entry->method = method;
+    entry->uncompressedSize = uncompressedSize;
+    entry->isDataKnown = isDataKnown;
+    entry->aesVersion = aesVersion;
+    entry->crc = isDataKnown && aesVersion != 2 ? crc : 0;
+    entry->compressedSize = isDataKnown ? compressedSize : 0;
+    entry->externalAttr = (0100000u | (mode & 07777 ? mode & 07777 : 0644)) << 16; // unix mode
+    if (uncompressedSize >= ZIP64_LOCAL_THRESHOLD || entry->compressedSize >= ZIP_MAX_32) {
+        entry->hasZip64LocalExtra = true;
+        entry->versionNeeded = ZIP_VERSION_ZIP64;
+    }
+    if (aesVersion) entry->versionNeeded = ZIP_VERSION_AES;
+
+    err = _my_zip_writer_write_local_header(writer, entry);
+    writer->nowDataOffset = writer->offset;
+    return err;
+}
+
+int my_zip_writer_write_data(MyZipWriter* writer, const void* data, size_t len) {
+    return _my_zip_writer_write(writer, data, len);
+}
+
+// record blocks written by my_zip_writer_write_block() into MY_ZIP_EXTRA_BLOCK_INDEX of current entry
+int my_zip_writer_begin_block_index(MyZipWriter* writer, uint64_t blockSize) {
+    _my_zip_writer_entry* entry = &writer->entries[writer->entriesCount - 1];
+    entry->blockIndex = (uint8_t*)malloc(MY_ZIP_BLOCK_INDEX_HEADER_SIZE + MY_ZIP_BLOCK_INDEX_ITEM_SIZE * 16);
+    if (entry->blockIndex == NULL) return ZIP_ER_MEMORY;
+    entry->blockIndex[0] = MY_ZIP_BLOCK_INDEX_VERSION;
+    _put64(entry->blockIndex + 1, blockSize);
+    _put32(entry->blockIndex + 9, 0);
+    entry->blockIndexLen = MY_ZIP_BLOCK_INDEX_HEADER_SIZE;
+    return 0;
+}
+
+// write compressed data of a block, and record it if my_zip_writer_begin_block_index() called
+int my_zip_writer_write_block(MyZipWriter* writer, const void* data, size_t len, uint32_t crc) {
+    _my_zip_writer_entry* entry = &writer->entries[writer->entriesCount - 1];
+    size_t count = entry->blockIndex ? (entry->blockIndexLen - MY_ZIP_BLOCK_INDEX_HEADER_SIZE) / MY_ZIP_BLOCK_INDEX_ITEM_SIZE : 0;
+    if (count >= 16 && (count & (count - 1)) == 0) { // capacity is doubled when full
+        uint8_t* p = (uint8_t*)realloc(entry->blockIndex, MY_ZIP_BLOCK_INDEX_HEADER_SIZE + MY_ZIP_BLOCK_INDEX_ITEM_SIZE * count * 2);
+        if (p == NULL) free(entry->blockIndex); // just don't record the index
+        entry->blockIndex = p;
+    }
+    if (entry->blockIndex) {
+        uint8_t* item = entry->blockIndex + entry->blockIndexLen;
+        _put32(item, (uint32_t)len);
+        _put32(item + 4, crc);
+        _put32(entry->blockIndex + 9, (uint32_t)(count + 1));
+        entry->blockIndexLen += MY_ZIP_BLOCK_INDEX_ITEM_SIZE;
+    }
+    return _my_zip_writer_write(writer, data, len);
+}
+
+int my_zip_writer_end_file(MyZipWriter* writer, uint32_t crc) {
+    _my_zip_writer_entry* entry = &writer->entries[writer->entriesCount - 1];
+    uint64_t compressedSize = writer->offset - writer->nowDataOffset;
+    if (entry->aesVersion == 2) crc = 0; // AE-2 relies on auth code instead of crc
+
+    if (entry->isDataKnown) {
+        if (entry->crc != crc || entry->compressedSize != compressedSize) return ZIP_ER_INCONS;
+        return 0;
+    }
+
+    entry->crc = crc;
+    entry->compressedSize = compressedSize;
+    if (!entry->hasZip64LocalExtra && compressedSize >= ZIP_MAX_32) return ZIP_ER_INCONS; // never happen
+
+    // update crc and compressed size in local header
+    uint8_t buf[8];
+    _put32(buf, crc);
+    int err = _my_zip_writer_pwrite(writer, entry->localHeaderOffset + 14, buf, 4);
+    if (err) return err;
+    if (entry->hasZip64LocalExtra) {
+        _put64(buf, compressedSize);
+        size_t nameLen = strlen(entry->name);
+        err = _my_zip_writer_pwrite(writer, entry->localHeaderOffset + 30 + nameLen + 12, buf, 8);
+    }
+    else {
+        _put32(buf, (uint32_t)compressedSize);
+        err = _my_zip_writer_pwrite(writer, entry->localHeaderOffset + 18, buf, 4);
+    }
+    return err;
+}
+
+static int _my_zip_writer_write_central_header(MyZipWriter* writer, _my_zip_writer_entry* entry) {
+    uint8_t hdr[46];
+    uint8_t extra[4 + 24 + ZIP_EXTRA_WINZIP_AES_SIZE];
+    size_t nameLen = strlen(entry->name);
+
+    // zip64 extra field only contains the values which are too large
+    uint16_t extraLen = 0;
+    uint16_t versionNeeded = entry->versionNeeded;
+    bool isZip64Size = entry->uncompressedSize >= ZIP_MAX_32;
+    bool isZip64CompressedSize = entry->compressedSize >= ZIP_MAX_32;
+    bool isZip64Offset = entry->localHeaderOffset >= ZIP_MAX_32;
+    if (isZip64Size || isZip64CompressedSize || isZip64Offset) {
+        extraLen = 4;
+        if (isZip64Size) { _put64(extra + extraLen, entry->uncompressedSize); extraLen += 8; }
+        if (isZip64CompressedSize) { _put64(extra + extraLen, entry->compressedSize); extraLen += 8; }
+        if (isZip64Offset) { _put64(extra + extraLen, entry->localHeaderOffset); extraLen += 8; }
+        _put16(extra, 0x0001);
+        _put16(extra + 2, extraLen - 4);
+        if (versionNeeded < ZIP_VERSION_ZIP64) versionNeeded = ZIP_VERSION_ZIP64;
+    }
+    if (entry->aesVersion) {
+        _my_zip_writer_put_aes_extra(extra + extraLen, entry);
+        extraLen += ZIP_EXTRA_WINZIP_AES_SIZE;
+    }
+    uint8_t blockIndexHdr[4];
+    size_t blockIndexLen = entry->blockIndex ? entry->blockIndexLen : 0;
+    if (blockIndexLen > (size_t)ZIP_MAX_16 - 4 - extraLen) blockIndexLen = 0; // too many blocks, extra field is full
+    if (blockIndexLen > 0) {
+        _put16(blockIndexHdr, MY_ZIP_EXTRA_BLOCK_INDEX);
+        _put16(blockIndexHdr + 2, (uint16_t)blockIndexLen);
+    }
+
+    _put32(hdr, ZIP_SIG_CENTRAL_HEADER);
+    _put16(hdr + 4, ZIP_VERSION_MADE_BY_UNIX | ZIP_VERSION_ZIP64);
+    _put16(hdr + 6, versionNeeded);
+    _put16(hdr + 8, _my_zip_writer_flags(entry));
+    _put16(hdr + 10, _my_zip_writer_method(entry));
+    _put16(hdr + 12, entry->dosTime);
+    _put16(hdr + 14, entry->dosDate);
+    _put32(hdr + 16, entry->crc);
+    _put32(hdr + 20, isZip64CompressedSize ? (uint32_t)ZIP_MAX_32 : (uint32_t)entry->compressedSize);
+    _put32(hdr + 24, isZip64Size ? (uint32_t)ZIP_MAX_32 : (uint32_t)entry->uncompressedSize);
+    _put16(hdr + 28, (uint16_t)nameLen);
+    _put16(hdr + 30, (uint16_t)(extraLen + (blockIndexLen ? 4 + blockIndexLen : 0)));
+    _put16(hdr + 32, 0); // comment length
+    _put16(hdr + 34, 0); // disk number start
+    _put16(hdr + 36, 0); // internal file attributes
+    _put32(hdr + 38, entry->externalAttr);
+    _put32(hdr + 42, isZip64Offset ? (uint32_t)ZIP_MAX_32 : (uint32_t)entry->localHeaderOffset);
+
+    int err = _my_zip_writer_write(writer, hdr, sizeof(hdr));
+    if (!err) err = _my_zip_writer_write(writer, entry->name, nameLen);
+    if (!err) err = _my_zip_writer_write(writer, extra, extraLen);
+    if (!err && blockIndexLen) err = _my_zip_writer_write(writer, blockIndexHdr, sizeof(blockIndexHdr));
+    if (!err && blockIndexLen) err = _my_zip_writer_write(writer, entry->blockIndex, blockIndexLen);
+    return err;
+}
+
+int my_zip_writer_close(MyZipWriter* writer) {
+    // write central directory and end of central directory record, then close file
+    int err = 0;
+    uint64_t cdOffset = writer->offset;
+    for (size_t i = 0; i < writer->entriesCount && !err; i++) {
+        err = _my_zip_writer_write_central_header(writer, &writer->entries[i]);
+    }
+    if (err) return err;
+
+    uint64_t cdSize = writer->offset - cdOffset;
+    uint64_t count = writer->entriesCount;
+    bool isZip64 = count >= ZIP_MAX_16 || cdSize >= ZIP_MAX_32 || cdOffset >= ZIP_MAX_32;
+    if (isZip64) {
+        uint8_t rec[56 + 20];
+        uint64_t zip64EocdOffset = writer->offset;
+        _put32(rec, ZIP_SIG_ZIP64_EOCD);
+        _put64(rec + 4, 56 - 12); // size of the remaining record
+        _put16(rec + 12, ZIP_VERSION_MADE_BY_UNIX | ZIP_VERSION_ZIP64);
+        _put16(rec + 14, ZIP_VERSION_ZIP64);
+        _put32(rec + 16, 0); // number of this disk
+        _put32(rec + 20, 0); // disk where central directory starts
+        _put64(rec + 24, count);
+        _put64(rec + 32, count);
+        _put64(rec + 40, cdSize);
+        _put64(rec + 48, cdOffset);
+
+        uint8_t* locator = rec + 56;
+        _put32(locator, ZIP_SIG_ZIP64_EOCD_LOCATOR);
+        _put32(locator + 4, 0);
+        _put64(locator + 8, zip64EocdOffset);
+        _put32(locator + 16, 1); // total number of disks
+        err = _my_zip_writer_write(writer, rec, sizeof(rec));
+        if (err) return err;
+    }
+
+    uint8_t eocd[22];
+    _put32(eocd, ZIP_SIG_EOCD);
+    _put16(eocd + 4, 0);
+    _put16(eocd + 6, 0);
+    _put16(eocd + 8, count >= ZIP_MAX_16 ? ZIP_MAX_16 : (uint16_t)count);
+    _put16(eocd + 10, count >= ZIP_MAX_16 ? ZIP_MAX_16 : (uint16_t)count);
+    _put32(eocd + 12, cdSize >= ZIP_MAX_32 ? (uint32_t)ZIP_MAX_32 : (uint32_t)cdSize);
+    _put32(eocd + 16, cdOffset >= ZIP_MAX_32 ? (uint32_t)ZIP_MAX_32 : (uint32_t)cdOffset);
+    _put16(eocd + 20, 0); // comment length
+    err = _my_zip_writer_write(writer, eocd, sizeof(eocd));
+    if (err) return err;
+
+    FILE* fp = writer->fp;
+    writer->fp = NULL;
+    if (fclose(fp) != 0) return ZIP_ER_WRITE;
+    return 0;
+}
+
+void my_zip_writer_destroy(MyZipWriter* writer) {
+    // NOTE: file is not deleted here
+    if (writer->fp) {
+        fclose(writer->fp);
+        writer->fp = NULL;
+    }
+    for (size_t i = 0; i < writer->entriesCount; i++) {
+        free(writer->entries[i].name);
+        free(writer->entries[i].blockIndex);
+    }
+    FREEIF(writer->entries);
+    writer->entriesCount = writer->entriesCapacity = 0;
+    if (writer->names) {
+        hashmap_free(writer->names, NULL);
+        writer->names = NULL;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "my_hashmap.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+// --------------------------------------------------------------------------
+// a minimal streaming .zip writer, used by zipDir() when creating a new zip file,
+// so compressed blocks are written into file as soon as they are ready
+// --------------------------------------------------------------------------
+
+// private extra field in central directory, records blocks of an entry compressed by threads,
+// so unzipToDir() can inflate blocks of a large entry in parallel, other zip tools just ignore it
+// layout: version(1) | blockSize(8) | count(4) | count * (compressedSize(4) | crc(4))
+// each block has 'blockSize' bytes of uncompressed data (except the last one),
+// and is an independent raw deflate stream (no dictionary of previous block), ends by sync flush
+#define MY_ZIP_EXTRA_BLOCK_INDEX 0x4e5a // "ZN"
+#define MY_ZIP_BLOCK_INDEX_VERSION 1
+#define MY_ZIP_BLOCK_INDEX_HEADER_SIZE 13
+#define MY_ZIP_BLOCK_INDEX_ITEM_SIZE 8
+
+typedef struct _my_zip_writer_entry { // central directory record of each entry
+    char* name;
+    uint64_t localHeaderOffset;
+    uint64_t compressedSize;
+    uint64_t uncompressedSize;
+    uint32_t crc;
+    uint16_t dosTime;
+    uint16_t dosDate;
+    uint16_t method;
+    uint16_t versionNeeded;
+    uint32_t externalAttr;
+    uint16_t aesVersion; // WinZip AES encryption: 0 if not encrypted, 1 for AE-1, 2 for AE-2 (crc is not stored)
+    uint8_t* blockIndex; // data of MY_ZIP_EXTRA_BLOCK_INDEX, NULL if not recorded
+    size_t blockIndexLen;
+    bool isDataKnown; // crc and compressed size are written into local header before data
+    bool hasZip64LocalExtra; // local header has zip64 extra field
+} _my_zip_writer_entry;
+
+typedef struct MyZipWriter {
+    FILE* fp;
+    uint64_t offset; // bytes written into 'fp'
+    _my_zip_writer_entry* entries;
+    size_t entriesCount;
+    size_t entriesCapacity;
+    HashMap* names; // all entry names, to avoid duplicated entries
+    uint64_t nowDataOffset; // offset of the data of the entry being written
+} MyZipWriter;
+
+int my_zip_writer_open(MyZipWriter* writer, const char* path);
+int my_zip_writer_add_dir(MyZipWriter* writer, const char* name, time_t mtime);
+int my_zip_writer_begin_file(MyZipWriter* writer, const char* name, time_t mtime, uint32_t mode, uint16_t method, uint64_t uncompressedSize, bool isDataKnown, uint32_t crc, uint64_t compressedSize, uint16_t aesVersion);
+int my_zip_writer_write_data(MyZipWriter* writer, const void* data, size_t len);
+int my_zip_writer_begin_block_index(MyZipWriter* writer, uint64_t blockSize);
+int my_zip_writer_write_block(MyZipWriter* writer, const void* data, size_t len, uint32_t crc);
+int my_zip_writer_end_file(MyZipWriter* writer, uint32_t crc);
+int my_zip_writer_close(MyZipWriter* writer);
+void my_zip_writer_destroy(MyZipWriter* writer);
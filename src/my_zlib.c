@@ -132,3 +132,10 @@ FFI_PLUGIN_EXPORT void closeUnzipStream(void* pStream) {
     inflateEnd((z_stream*)pStream);
     free(pStream);
 }
+
+// --------------------------------------------------------------------------
+
+FFI_PLUGIN_EXPORT const char* getZlibVersion() {
+    // NOTE: zlib-ng in zlib-compat mode returns version like "1.3.1.zlib-ng"
+    return zlibVersion();
+}
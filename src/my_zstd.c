@@ -0,0 +1,66 @@
+#ifdef NATIVE_ZIP_ZSTD
+
+#include "my_compress.h"
+
+#include <zip.h>
+#include <zstd.h>
+
+// NOTE: each block is compressed into an independent zstd frame,
+//       zstd decoder accepts concatenated frames, so all blocks of a file are still valid zstd data
+
+static void* _my_zstd_compress_init(int level) {
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    if (cctx == NULL) return NULL;
+    if (level < 1) level = 1;
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 0); // zip already has crc32
+    return cctx;
+}
+
+static int _my_zstd_compress_reset(void* stream) {
+    size_t ret = ZSTD_CCtx_reset((ZSTD_CCtx*) stream, ZSTD_reset_session_only);
+    return ZSTD_isError(ret) ? -1 : 0;
+}
+
+static size_t _my_zstd_compress_next(void* stream, char* inBuf, size_t inBufLen, char* outBuf, size_t outBufSize, MY_FLUSH_TYPE flushState) {
+    ZSTD_CCtx* cctx = (ZSTD_CCtx*) stream;
+    ZSTD_EndDirective mode = flushState == MY_FLUSH_NO ? ZSTD_e_continue : ZSTD_e_end; // end the frame at block boundary
+    ZSTD_inBuffer in = { inBuf, inBufLen, 0 };
+    ZSTD_outBuffer out = { outBuf, outBufSize, 0 };
+
+    while (1) {
+        size_t remaining = ZSTD_compressStream2(cctx, &out, &in, mode);
+        if (ZSTD_isError(remaining)) return MY_COMPRESS_ERROR;
+        if (mode == ZSTD_e_continue ? in.pos == in.size : remaining == 0) break;
+        if (out.pos == out.size) return MY_COMPRESS_ERROR; // never happen, output buffer is big enough
+    }
+    return out.pos;
+}
+
+static size_t _my_zstd_compress_bound(size_t len) {
+    return ZSTD_compressBound(len);
+}
+
+static size_t _my_zstd_compress_whole(void* stream, const char* inBuf, size_t inBufLen, char* outBuf, size_t outBufSize) {
+    ZSTD_CCtx* cctx = (ZSTD_CCtx*) stream;
+    if (_my_zstd_compress_reset(cctx) != 0) return MY_COMPRESS_ERROR;
+    size_t ret = ZSTD_compress2(cctx, outBuf, outBufSize, inBuf, inBufLen);
+    return ZSTD_isError(ret) ? MY_COMPRESS_ERROR : ret;
+}
+
+static void _my_zstd_compress_destroy(void* stream) {
+    ZSTD_freeCCtx((ZSTD_CCtx*) stream);
+}
+
+const MyCompressBackend _my_zstd_backend = {
+    ZIP_CM_ZSTD,
+    _my_zstd_compress_init,
+    _my_zstd_compress_reset,
+    NULL, // decoder doesn't know data of previous frame
+    _my_zstd_compress_next,
+    _my_zstd_compress_bound,
+    _my_zstd_compress_whole,
+    _my_zstd_compress_destroy,
+};
+
+#endif
@@ -44,6 +44,8 @@ FFI_PLUGIN_EXPORT void closeZipStream(void* pStream);
 FFI_PLUGIN_EXPORT void* openUnzipStream(int windowBits);
 FFI_PLUGIN_EXPORT void closeUnzipStream(void* pStream);
 
+FFI_PLUGIN_EXPORT const char* getZlibVersion(); // version of zlib linked at runtime, e.g. "1.3.1", or "1.3.1.zlib-ng"
+
 
 // --------------------------------------------------------------------------
 // zip utils
@@ -54,6 +56,7 @@ typedef struct NativeZipTaskProgressInfo {
     size_t total_fileSize;
     size_t processed_fileSize;
     size_t processed_compressSize;
+    size_t stored_fileSize; // part of 'processed_fileSize' stored without compression
 } NativeZipTaskProgressInfo;
 
 #include <stdbool.h>
@@ -68,8 +71,20 @@ typedef struct NativeZipTaskInfo {
     STRUCT_NativeZipTaskInfo
 } NativeZipTaskInfo;
 
-FFI_PLUGIN_EXPORT void* zipDirAsync(void* _zip, bool hasPassword, const char** dirPathList, int dirPathListCount, const char* entryDirPathBase, int compressLevel, int skipTopLevel, int threadCount);
-FFI_PLUGIN_EXPORT void* unzipToDirAsync(void* _zip, const char *password, const char *zipFilePath, const char **entryPathsArr, int entriesCount, const char *toDirPath, int threadCount);
+typedef enum NativeZipFlags {
+    NZ_FLAG_STORE_BY_EXTENSION = 1, // store files without compression if extension is .jpg, .mp4, .zip, ...
+    NZ_FLAG_STORE_BY_MAGIC = 2, // store files without compression if file starts with magic bytes of compressed format
+    NZ_FLAG_STORE_BY_SAMPLE = 4, // store files without compression if the first 64KB cannot be compressed
+    NZ_FLAG_STORE_BY_ALL = NZ_FLAG_STORE_BY_EXTENSION | NZ_FLAG_STORE_BY_MAGIC | NZ_FLAG_STORE_BY_SAMPLE,
+    NZ_FLAG_SYNC = 8, // skip files already in .zip with the same size and modified time, keep the compressed data of the entries
+    NZ_FLAG_SYNC_CRC = 16, // with NZ_FLAG_SYNC, also compare crc of file content
+    NZ_FLAG_ADAPTIVE_THREADS = 32, // change count of active compress threads (at most 'threadCount') by measured throughput
+    NZ_FLAG_BLOCK_INDEX = 64, // compress blocks of large files independently and record them in .zip, so they can be extracted by threads
+    NZ_FLAG_NO_CACHE = 128, // unzip: drop data of large extracted files from page cache after written to disk
+} NativeZipFlags;
+
+FFI_PLUGIN_EXPORT void* zipDirAsync(void* _zip, const char* zipFilePath, const char* password, const char** dirPathList, int dirPathListCount, const char* entryDirPathBase, int compressLevel, int compressMethod, int skipTopLevel, int threadCount, int64_t maxBlockSize, int64_t maxMemoryUsage, int flags);
+FFI_PLUGIN_EXPORT void* unzipToDirAsync(void* _zip, const char *password, const char *zipFilePath, const char **entryPathsArr, int entriesCount, const char *toDirPath, int threadCount, int flags);
 
 FFI_PLUGIN_EXPORT int zipRenameEntryAsync(void* _zip, const char* entryPath, const char* newEntryPath);
 FFI_PLUGIN_EXPORT int zipMoveEntriesAsync(void* _zip, const char** entryPaths, int entriesCount, const char* newEntryBasePath);
@@ -97,7 +112,9 @@ FFI_PLUGIN_EXPORT void nativeFree(void* p);
 
 FFI_PLUGIN_EXPORT void* readZipFileEntryOpenByIndex(void* zip, int index);
 FFI_PLUGIN_EXPORT void* readZipFileEntryOpen(void* zip, const char* entryPath);
+FFI_PLUGIN_EXPORT int getZipEntryIndex(void* zip, const char* entryPath);
 FFI_PLUGIN_EXPORT int readZipFileEntry(void* zipEntryFile, int8_t* buf, int len);
+FFI_PLUGIN_EXPORT int readZipFileEntrySeek(void* zip, int index, int64_t offset, int8_t* buf, int len);
 FFI_PLUGIN_EXPORT int readZipFileEntryClose(void* zipEntryFile);
 
 